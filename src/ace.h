@@ -0,0 +1,336 @@
+#ifndef ACE_H
+#define ACE_H
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <math.h>
+#ifdef ACE_USE_ABC
+#include "base/abc/abc.h"
+#endif
+
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define FIX_NEG_ZERO(x) (fabs(x) < 1e-10 ? 0.0 : (x))
+
+#define MAX_LIB_CELLS 64 // cells per function (size variants) in the library
+#define LIB_MAX_PINS 6 // cell inputs, truth tables are 64-bit
+#define LIB_TRUTH_INV 0x1ull // truth tables: bit m is the output for input minterm m
+#define LIB_TRUTH_NAND2 0x7ull
+#define CORNER_MAX 8 // library corners timed in one pass, the nominal library is corner 0
+
+//***********************************************************
+// structures
+typedef struct lib_arc{
+	// pin to output delay = intrinsic + slope * load
+	double intrinsic;
+	double slope;
+} lib_arc;
+
+typedef struct lib_cell{
+	char *name;
+	double area;
+	unsigned long long truth;	// output over the 2^pins input minterms, pin k is bit k of the minterm
+	unsigned char pins;
+	short function;	// index in cell_library.functions
+	int arc;	// arcs of pin 0 .. pins-1 are cell_library.arcs[arc ...]
+	double timing[2];	// slowest arc: timing[0]: fixed timing, timing[1]: timing *= output
+} lib_cell;
+
+typedef struct lib_function{
+	unsigned long long truth;
+	unsigned char pins;
+	int first;	// its cells are cell_library.cells[first .. first+count-1], by increasing area
+	int count;
+} lib_function;
+
+typedef struct cell_library{
+	// flat cell table grouped by function, built by parseLib() and sortLib()
+	lib_cell *cells;
+	int ncells;
+	lib_arc *arcs;
+	int narcs;
+	lib_function *functions;
+	int nfunctions;
+	int *index;	// open addressing (pins, truth) -> function, see libFunction()
+	int index_size;
+} cell_library;
+
+typedef struct lib_table{
+	// library characterized per load (fanout count), built once by characterizeLib()
+	int max_load;	// tables cover loads 0 .. max_load
+	double *inv_delay;	// inv_delay[load*inv_count + cell]
+	double *nand_delay;	// nand_delay[load*nand_count + cell]
+	short *inv_fastest;	// per load, fastest cell (smallest area on ties) / -1: empty library
+	short *nand_fastest;
+	// per load, Pareto-optimal cells by increasing area and strictly decreasing delay:
+	// inv_pareto[load*inv_count + k], k < inv_pareto_n[load]
+	short *inv_pareto;
+	short *inv_pareto_n;
+	short *nand_pareto;
+	short *nand_pareto_n;
+} lib_table;
+
+#define INV_DELAY(load, cell) (libt.inv_delay[(load)*inv_count + (cell)])
+#define NAND_DELAY(load, cell) (libt.nand_delay[(load)*nand_count + (cell)])
+
+typedef struct timing_corner{
+	char *name;
+	double intrinsic;	// delay derates: intrinsic * timing[0] + slope * timing[1] * load
+	double slope;
+	double target;	// required time of the outputs, 0: from the global target
+	int relative;	// target is a factor of the corner's fastest delay
+} timing_corner;
+
+typedef struct timing_port{
+	char *name;
+	int output;	// 0: PI arrival, 1: PO required time
+	double time;
+} timing_port;
+
+typedef struct timing_constraints{
+	// --constraints / --target, shared read-only by every circuit
+	double target;	// required time of the outputs
+	int relative;	// target is a factor of the fastest delay
+	int nports;
+	timing_port *ports;	// sorted by name
+	int ncorners;	// including the nominal corner 0
+	timing_corner corner[CORNER_MAX];
+} timing_constraints;
+
+enum {GATE, PI, PO, INVERTER}; // timing_graph node type, INVERTER: shared inverter (--share-inv)
+
+typedef struct timing_graph{
+	// nodes are stored in topological order (PI, GATE, PO) as parallel arrays,
+	// so the forward/backward sweeps only stream through the fields they touch
+	unsigned int n;	// node count
+	unsigned int cap;	// allocated node capacity
+	unsigned char *type;	// GATE / PI / PO
+	unsigned char *compl;	// bit0: fanin0 inverted, bit1: fanin1 inverted
+	int *fanin0;	// fanin0 node index / -1 (PO: constant output, value in bit0 of compl), INVERTER: its input
+	int *fanin1;	// fanin1 node index / -1
+	double *arrival;	// node output arrival time
+	double *required;	// node required time
+	double *slack;	// nand slack
+	double *inv_slack0;	// inv0 slack
+	double *inv_slack1;	// inv1 slack
+	short *nand_id;	// using NAND_id in library / -1: not NAND gate
+	short *inv0_id;	// fanin0 using inverter_id in library / -1: no inverter
+	short *inv1_id;	// fanin1 using inverter_id in library / -1: no inverter
+	char **name;	// PI / PO name, NULL for gates
+	// CSR fanout list: fanouts of node i are fanout[fanout_start[i]] ... fanout[fanout_start[i+1]-1]
+	int *fanout_start;	// n+1 entries
+	int *fanout;
+	// nodes bucketed by logic level: level l is level_nodes[level_start[l]] ... level_nodes[level_start[l+1]-1]
+	int nlevels;
+	int *level_start;	// nlevels+1 entries
+	int *level_nodes;
+	struct sta_state *sta;	// incremental timing queues, NULL until staInit()
+	double *port_time;	// constraints: PI arrival / PO required time (NAN: the target), NULL: none
+	// per-circuit results of initialDelay() and optimization()
+	double initial_delay;	// max PO arrival with the fastest cells, the delay constraint
+	double original_area;	// area with the fastest cells
+	double optimized_area;
+	unsigned int inv_cells;	// inverters and NANDs placed by initialDelay()
+	unsigned int nand_cells;
+} timing_graph;
+
+#define COMPL0(g, i) ((g)->compl[i] & 1)
+#define COMPL1(g, i) (((g)->compl[i] >> 1) & 1)
+#define FANOUT_NUM(g, i) ((g)->fanout_start[(i)+1] - (g)->fanout_start[i])
+// PI arrival and PO required time under the constraints
+#define PI_ARRIVAL(g, i) ((g)->port_time ? (g)->port_time[i] : 0.0)
+#define PO_REQUIRED(g, i, target) ((g)->port_time && !isnan((g)->port_time[i]) ? (g)->port_time[i] : (target))
+// load of the inverters on node i's fanins: an INVERTER node drives its fanouts, edge inverters one input
+#define INV_LOAD(g, i) ((g)->type[i] == INVERTER ? FANOUT_NUM(g, i) : 1)
+
+//***********************************************************
+// cell library (lib.c)
+extern cell_library cell_lib;
+extern unsigned int inv_count;
+extern lib_cell *inverters;
+extern unsigned int nand_count;
+extern lib_cell *nands;
+extern lib_table libt;
+
+int parseLib();
+void sortLib();
+int libFunction(int pins, unsigned long long truth);
+void characterizeLib(int max_load);
+void libUse(int max_load);
+void libDone();
+unsigned long long libHash();
+int smallestInv(int load, double budget);
+int smallestNand(int load, double budget);
+
+//***********************************************************
+// timing graph (main.c)
+double wallTime();
+void graphReserve(timing_graph *g, unsigned int cap);
+void graphFree(timing_graph *g);
+void graphBuildFanouts(timing_graph *g);
+void graphBuildLevels(timing_graph *g);
+int graphAddNode(timing_graph *g, int type, int fanin0, int fanin1, int compl, char *name);
+char *outputName(const char *input, const char *ext);
+void mapping(timing_graph *g);
+void initialDelay(timing_graph *g);
+void optimization(timing_graph *g);
+
+//***********************************************************
+// netlist reader (read.c)
+int readNetwork(timing_graph *g, const char *file_name, size_t *bytes);
+int graphMaxFanout(timing_graph *g);
+unsigned int graphInverters(timing_graph *g);
+double nodeArea(timing_graph *g, int i);
+double graphArea(timing_graph *g);
+
+//***********************************************************
+// inverter restructuring (invert.c)
+void shareInverters(timing_graph *g, int limit);
+int assignPolarity(timing_graph *g);
+
+//***********************************************************
+// AIG restructuring (restruct.c)
+double restructure(timing_graph *g, double budget, int verbose);
+
+//***********************************************************
+// netlist writers (write.c)
+int Write(const char *pFileName, timing_graph *g, int slack_on);
+int WriteBinary(const char *file_name, timing_graph *g, int slack_on);
+void writeThreadDone();
+
+//***********************************************************
+// result cache (cache.c)
+typedef struct cache_result{
+	// the summary of a cached run
+	unsigned int nodes;
+	double initial_delay;
+	double original_area;
+	double optimized_area;
+	double worst_slack;
+} cache_result;
+
+unsigned long long hashMix(unsigned long long h, unsigned long long v);
+unsigned long long hashDouble(unsigned long long h, double x);
+unsigned long long hashText(unsigned long long h, const char *s);
+unsigned long long graphHash(timing_graph *g);
+int cacheLoad(const char *dir, unsigned long long key, const char *input, int binary, int verified, cache_result *r);
+void cacheStore(const char *dir, unsigned long long key, const char *input, int binary, int verified, const cache_result *r);
+int cacheSeedCones(const char *dir, timing_graph *g, const char *input, unsigned long long context, double target);
+void cacheStoreCones(const char *dir, timing_graph *g, const char *input, unsigned long long context);
+
+//***********************************************************
+// netlist check (verify.c)
+int verifyNetlist(const char *input, const char *netlist_file, timing_graph *g, int verbose);
+
+//***********************************************************
+// timing report (report.c)
+int timingReport(const char *file_name, timing_graph *g, double target, int paths);
+
+//***********************************************************
+// resident sizing server (serve.c)
+int serveSocket(const char *path, const timing_constraints *constraints, int slack_on);
+
+//***********************************************************
+// incremental static timing (sta.c)
+enum {STA_NAND, STA_INV0, STA_INV1}; // which cell of a node staResize() swaps
+
+double invDelay(int inv_id);
+double nodeInvDelay(timing_graph *g, int node, int inv_id);
+double nandDelay(timing_graph *g, int node, int nand_id);
+void staInit(timing_graph *g);
+void staFree(timing_graph *g);
+void staThreads(int n);
+void staForward(timing_graph *g);
+void staBackward(timing_graph *g, double target);
+void staFull(timing_graph *g, double target);
+void staResize(timing_graph *g, int node, int pin, int cell);
+void staTouch(timing_graph *g, int node);
+int staUpdate(timing_graph *g);
+void staSlacks(timing_graph *g);
+void staCorners(timing_graph *g, const timing_corner *corner, int nc, const double *port, const double *po_required,
+	double *arrival, double *required);
+
+//***********************************************************
+// full pass kernels (stavec.c)
+typedef struct sta_layout{
+	// a graph's nodes at their level_nodes positions k, built once per graph structure
+	int n;	// nodes laid out, 0: none
+	int *pos;	// node -> position
+	int *fanin;	// fanin[k], fanin[n + k]: positions of pin 0 and pin 1 (pin 0 again for one pin)
+	int *sink_start;	// pins read by position k: sink[sink_start[k]] .. sink[sink_start[k+1]-1]
+	int *sink;	// a pin as its delay index: k + n * pin
+	// packed by every pass: forward pin inverter delays (0: none) and NAND delays, backward
+	// pin edge delays (turned into the required time at the pin) and PO required times
+	double *delay;	// delay[k], delay[n + k]: pin 0, pin 1
+	double *node;
+	double *time;	// arrival / required time
+} sta_layout;
+
+int staKernel(const char *name);
+const char *staKernelName(void);
+void staKernelForward(sta_layout *l, int lo, int hi);
+void staKernelBackward(sta_layout *l, int lo, int hi);
+
+//***********************************************************
+// timing constraints and corners (constr.c)
+#define CORNER_ROUNDS 4 // sizing runs per circuit while a corner fails
+
+typedef struct corner_timing{
+	// corner timing of one circuit
+	int nc;	// corners, 0: nominal only
+	double target[CORNER_MAX];	// output required time per corner
+	double *port;	// the constrained port times, NULL: none
+	double *po_required;	// po_required[i*nc + k]: output i at corner k, never before its fastest arrival
+	double *po_fastest;	// nominal arrival of each node with the fastest cells
+	double *arrival;	// arrival[i*nc + k]: node i at corner k
+	double *required;
+} corner_timing;
+
+void defaultConstraints(timing_constraints *c);
+int readConstraints(timing_constraints *c, const char *file_name);
+int parseTarget(const char *s, double *target, int *relative);
+unsigned long long constraintsHash(const timing_constraints *c);
+int parseSweep(const char *s, double *lo, double *hi, double *step, int *relative);
+void freeConstraints(timing_constraints *c);
+int constrainPorts(timing_graph *g, const timing_constraints *c);
+double constraintTarget(const timing_constraints *c, double fastest);
+int relaxRequired(timing_graph *g, double target);
+void cornerStart(corner_timing *ct, timing_graph *g, const timing_constraints *c, double target, double fastest);
+int cornerCheck(corner_timing *ct, timing_graph *g, const timing_constraints *c, int verbose, int tighten);
+void cornerFree(corner_timing *ct);
+
+//***********************************************************
+// sizers (sizer.c)
+int sizeLR(timing_graph *g, double target, double budget);
+int sizeDP(timing_graph *g, double target);
+void sizerThreadDone();
+
+//***********************************************************
+// partitioned sizing (part.c)
+int sizePartitions(timing_graph *g, double target, int parts, int workers, int exact, int verbose);
+
+//***********************************************************
+// profiling (prof.c)
+enum {PROF_NODES, PROF_CELLS, PROF_SWAPS, PROF_INV_ADDED, PROF_INV_REMOVED, PROF_COUNTERS}; // --profile counters
+
+extern int prof_on;
+extern __thread long prof_count[PROF_COUNTERS];
+#define PROF_COUNT(counter, n) do{ if(prof_on) prof_count[counter] += (n); }while(0)
+
+void profStart();
+void profCircuit(const char *circuit);
+void profBegin(const char *phase);
+void profEnd();
+int profWrite(const char *prefix);
+
+//***********************************************************
+// synthetic benchmarks (stitch.c)
+int stitchCircuits(char **inputs, int ninputs, long target, const char *file_name);
+
+#endif
@@ -0,0 +1,135 @@
+#!/bin/sh
+# Benchmark and regression check over ISCAS85/*.blif (run from src/, see "make bench").
+#
+#   sh bench.sh              run every circuit, compare against ../results, exit 1 on a regression
+#   sh bench.sh baseline     record the runtimes as the new baseline (../results/bench_runtime.txt)
+#   sh bench.sh scale        stitch 10^5..10^SCALE_MAX node AIGs out of ISCAS85 and time them
+#   sh bench.sh kernels      nodes/ns of the full timing passes for every kernel (--sta-kernel)
+#                            on c7552 and a stitched 10^KERNEL_SCALE node AIG
+#
+# A circuit regresses when its initial delay differs from the golden .mbench header, its
+# optimized area is larger, its .mbench fails --verify (one extra, untimed run), or its
+# runtime (best of BENCH_RUNS) exceeds the baseline by more than BENCH_RATIO times plus
+# BENCH_MARGIN seconds. Extra ace options go in ACE_FLAGS.
+
+ACE=${ACE:-./ace}
+GOLDEN=${GOLDEN:-../results}
+BASELINE=${BASELINE:-$GOLDEN/bench_runtime.txt}
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_RATIO=${BENCH_RATIO:-1.5}
+BENCH_MARGIN=${BENCH_MARGIN:-0.02}
+SCALE_MAX=${SCALE_MAX:-6}
+SCALE_DIR=${SCALE_DIR:-/tmp}
+KERNEL_SCALE=${KERNEL_SCALE:-7}
+KERNEL_PASSES=${KERNEL_PASSES:-20}
+MODE=${1:-check}
+
+if [ ! -x "$ACE" ]; then
+	echo "Error: $ACE not found, run make first"
+	exit 1
+fi
+
+run() {
+	# best of BENCH_RUNS runs of one circuit: "delay area_before area_after read map delay opt write total rss"
+	best=""
+	r=0
+	while [ $r -lt $BENCH_RUNS ]; do
+		line=$($ACE $ACE_FLAGS "$1" | awk '
+			/^initial_delay:/ {d = $2}
+			/^original_area:/ {a0 = $2}
+			/^optimized_area:/ {a1 = $2}
+			/^runtime \(s\)/ {t1 = $4; t2 = $6; t3 = $8; t4 = $10; t5 = $12}
+			/^peak_rss:/ {rss = $2}
+			END {printf "%s %s %s %s %s %s %s %s %.4f %s\n", d, a0, a1, t1, t2, t3, t4, t5, t1 + t2 + t3 + t4 + t5, rss}')
+		if [ -z "$best" ] || [ "$(echo "$line $best" | awk '{print ($9 < $19)}')" = 1 ]; then
+			best=$line
+		fi
+		r=$((r + 1))
+	done
+	echo "$best"
+}
+
+if [ "$MODE" = scale ]; then
+	printf "%-10s %10s %10s %10s %10s %10s %10s %10s\n" nodes read map delay opt write total rss_kb
+	n=5
+	while [ $n -le $SCALE_MAX ]; do
+		nodes=$(awk "BEGIN {printf \"%d\", 10^$n}")
+		aig=$SCALE_DIR/ace_stitch_$nodes.aig
+		[ -f "$aig" ] || $ACE --stitch $nodes "$aig" ISCAS85/*.blif > /dev/null
+		BENCH_RUNS=1
+		set -- $(run "$aig")
+		printf "%-10s %10s %10s %10s %10s %10s %10s %10s\n" $nodes $4 $5 $6 $7 $8 $9 ${10}
+		rm -f "$aig" "${aig%.aig}.mbench"
+		n=$((n + 1))
+	done
+	exit 0
+fi
+
+if [ "$MODE" = kernels ]; then
+	# best of BENCH_RUNS runs of --sta-bench per kernel, kernels the CPU lacks are skipped
+	nodes=$(awk "BEGIN {printf \"%d\", 10^$KERNEL_SCALE}")
+	aig=$SCALE_DIR/ace_stitch_$nodes.aig
+	$ACE --stitch $nodes "$aig" ISCAS85/*.blif > /dev/null
+	printf "%-12s %-8s %10s %10s\n" circuit kernel ms/pass nodes/ns
+	for circuit in ISCAS85/c7552.blif "$aig"; do
+		passes=$KERNEL_PASSES
+		[ "$circuit" = "$aig" ] || passes=$((KERNEL_PASSES * 100))
+		for kernel in scalar avx2 avx512; do
+			best=""
+			r=0
+			while [ $r -lt $BENCH_RUNS ]; do
+				line=$($ACE --sta-kernel $kernel --sta-bench $passes "$circuit" | awk '/^sta-bench:/ {print $8, $10}')
+				[ -n "$line" ] || break
+				if [ -z "$best" ] || [ "$(echo "$line $best" | awk '{print ($1 < $3)}')" = 1 ]; then
+					best=$line
+				fi
+				r=$((r + 1))
+			done
+			[ -n "$best" ] && printf "%-12s %-8s %10s %10s\n" $(basename "$circuit" | cut -d. -f1) $kernel $best
+		done
+	done
+	rm -f "$aig" "${aig%.aig}.mbench"
+	exit 0
+fi
+
+if [ "$MODE" = baseline ]; then
+	: > "$BASELINE"
+fi
+
+status=0
+printf "%-8s %9s %10s %10s %8s %8s %8s %8s %8s %8s %8s  %s\n" circuit delay area_before area_after \
+	read map delay opt write total rss_kb result
+for blif in ISCAS85/*.blif; do
+	c=$(basename "$blif" .blif)
+	set -- $(run "$blif")
+	result=ok
+	golden=$GOLDEN/$c.mbench
+	if [ -f "$golden" ]; then
+		# golden header: "Initial delay : x" / "Original area : x" / "Optimized area : x"
+		gd=$(sed -n 1p "$golden" | awk '{print $4}')
+		ga=$(sed -n 3p "$golden" | awk '{print $4}')
+		if [ "$(echo "$1 $gd" | awk '{print ($1 - $2 > 0.0005 || $2 - $1 > 0.0005)}')" = 1 ]; then
+			result="DELAY($gd)"
+		elif [ "$(echo "$3 $ga" | awk '{print ($1 > $2 + 0.0005)}')" = 1 ]; then
+			result="AREA($ga)"
+		fi
+	else
+		result="no-golden"
+	fi
+	if ! $ACE $ACE_FLAGS --verify "$blif" > /dev/null; then
+		# the written netlist doesn't compute the circuit (or the run failed)
+		result=VERIFY
+	fi
+	if [ "$MODE" = baseline ]; then
+		echo "$c $9" >> "$BASELINE"
+	elif [ -f "$BASELINE" ] && [ "$result" = ok ]; then
+		bt=$(awk -v c=$c '$1 == c {print $2}' "$BASELINE")
+		if [ -n "$bt" ] && [ "$(echo "$9 $bt $BENCH_RATIO $BENCH_MARGIN" | awk '{print ($1 > $2 * $3 + $4)}')" = 1 ]; then
+			result="TIME($bt)"
+		fi
+	fi
+	[ "$result" = ok ] || [ "$result" = no-golden ] || status=1
+	printf "%-8s %9.3f %10.3f %10.3f %8.4f %8.4f %8.4f %8.4f %8.4f %8.4f %8s  %s\n" $c $1 $2 $3 $4 $5 $6 $7 $8 $9 ${10} $result
+done
+[ $status = 0 ] && echo "bench: no regression" || echo "bench: REGRESSION"
+exit $status
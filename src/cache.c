@@ -0,0 +1,381 @@
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ace.h"
+
+// Result cache (--cache DIR). A run is keyed by a hash of the graph as read
+// (the strashed AIG, node by node with the port names), the parsed library,
+// the constraints and the options that shape the netlist. An entry is
+// DIR/<key>.mbench (and .mbin), written by the run that missed, and
+// DIR/<key>.result with its summary, written last so a half stored entry is
+// never read; files are written under a temporary name and renamed, so
+// concurrent runs sharing DIR (--batch) don't see each other's partial files.
+// A hit copies the netlist out and skips everything after the read.
+//
+// A miss can still reuse the sizing of the fanout-free cones (the trees of
+// --sizer dp: a NAND or shared inverter with one fanout belongs to its fanout's
+// tree) from the circuit's previous run with the same library, constraints and
+// options, DIR/<circuit>-<context>.cones. A cone is keyed
+// by the structural hash of its root's whole fanin cone and the fanout counts
+// of its nodes, so an edit only changes the keys of the cones it reaches.
+// Stored cells go onto the matching cones; if the circuit then meets its
+// target the sizer is skipped and only the greedy pass runs, resizing the new
+// cones and spending what slack is left, otherwise the run starts over from the
+// fastest cells.
+
+#define CACHE_VERSION 1
+#define CONES_MAGIC "ACEC"
+
+unsigned long long hashMix(unsigned long long h, unsigned long long v){
+	h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+	h *= 0xbf58476d1ce4e5b9ull;
+	return h ^ (h >> 31);
+}
+
+unsigned long long hashDouble(unsigned long long h, double x){
+	unsigned long long v;
+	memcpy(&v, &x, sizeof(v));
+	return hashMix(h, v);
+}
+
+unsigned long long hashText(unsigned long long h, const char *s){
+	if(!s) return hashMix(h, 0);
+	unsigned long long v = 0xcbf29ce484222325ull;	// FNV-1a
+	for(; *s; s++) v = (v ^ (unsigned char)*s) * 0x100000001b3ull;
+	return hashMix(h, v);
+}
+
+unsigned long long graphHash(timing_graph *g){
+	// the graph as read: node order, types, edges and port names
+	unsigned long long h = hashMix(CACHE_VERSION, g->n);
+	for(unsigned int i = 0; i < g->n; i++){
+		h = hashMix(h, (unsigned long long)g->type[i] << 8 | g->compl[i]);
+		h = hashMix(h, (unsigned long long)(unsigned int)g->fanin0[i] << 32 | (unsigned int)g->fanin1[i]);
+		if(g->name[i]) h = hashText(h, g->name[i]);
+	}
+	return h;
+}
+
+//***********************************************************
+// files
+static char *cachePath(const char *dir, const char *name, const char *ext){
+	char *path = malloc(strlen(dir) + strlen(name) + strlen(ext) + 2);
+	sprintf(path, "%s/%s%s", dir, name, ext);
+	return path;
+}
+
+static char *keyName(unsigned long long key){
+	char *name = malloc(17);
+	sprintf(name, "%016llx", key);
+	return name;
+}
+
+static char *conesPath(const char *dir, const char *input, unsigned long long context){
+	// DIR/<the input's file name without directory and extension>-<context>.cones
+	const char *base = strrchr(input, '/');
+	char ext[32];
+	sprintf(ext, "-%016llx.cones", context);
+	char *name = outputName(base ? base + 1 : input, ext);
+	char *path = cachePath(dir, name, "");
+	free(name);
+	return path;
+}
+
+static FILE *openTemp(const char *dir, char **temp){
+	// a new file in dir for publish()
+	*temp = cachePath(dir, ".tmpXXXXXX", "");
+	int fd = mkstemp(*temp);
+	FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+	if(!file){
+		if(fd >= 0) close(fd);
+		free(*temp);
+		*temp = NULL;
+	}
+	return file;
+}
+
+static int publish(FILE *file, char *temp, const char *path){
+	// close a file of openTemp() and move it to path
+	int ok = fclose(file) == 0 && rename(temp, path) == 0;
+	if(!ok) unlink(temp);
+	free(temp);
+	return ok;
+}
+
+static int copyFile(const char *from, const char *to, const char *dir){
+	// with dir: to is published through a temporary file of dir
+	FILE *in = fopen(from, "rb");
+	if(!in) return 0;
+	char *temp = NULL;
+	FILE *out = dir ? openTemp(dir, &temp) : fopen(to, "wb");
+	if(!out){
+		fclose(in);
+		return 0;
+	}
+	char buf[1 << 16];
+	size_t n;
+	int ok = 1;
+	while(ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) ok = fwrite(buf, 1, n, out) == n;
+	ok = ok && !ferror(in);
+	fclose(in);
+	if(dir && !ok){
+		// a partial copy is never published
+		fclose(out);
+		unlink(temp);
+		free(temp);
+		return 0;
+	}
+	if(dir) return publish(out, temp, to);
+	return (fclose(out) == 0) && ok;
+}
+
+//***********************************************************
+// whole results
+int cacheLoad(const char *dir, unsigned long long key, const char *input, int binary, int verified, cache_result *r){
+	// a stored run of key: copies its netlists next to input, returns 0 on a miss
+	char *name = keyName(key);
+	char *path = cachePath(dir, name, ".result");
+	FILE *file = fopen(path, "r");
+	int version = 0, has_binary = 0, has_verified = 0;
+	int ok = file && fscanf(file, "%d %u %lf %lf %lf %lf %d %d", &version, &r->nodes, &r->initial_delay, &r->original_area,
+		&r->optimized_area, &r->worst_slack, &has_binary, &has_verified) == 8;
+	if(file) fclose(file);
+	ok = ok && version == CACHE_VERSION && (has_binary || !binary) && (has_verified || !verified);
+	const char *ext[2] = {".mbench", ".mbin"};
+	for(int k = 0; ok && k < 1 + binary; k++){
+		char *from = cachePath(dir, name, ext[k]), *to = outputName(input, ext[k]);
+		ok = copyFile(from, to, NULL);
+		free(from);
+		free(to);
+	}
+	free(path);
+	free(name);
+	return ok;
+}
+
+void cacheStore(const char *dir, unsigned long long key, const char *input, int binary, int verified, const cache_result *r){
+	// after Write(): input's netlists and r as the entry of key
+	mkdir(dir, 0777);
+	char *name = keyName(key);
+	const char *ext[2] = {".mbench", ".mbin"};
+	int ok = 1;
+	for(int k = 0; ok && k < 1 + binary; k++){
+		char *from = outputName(input, ext[k]), *to = cachePath(dir, name, ext[k]);
+		ok = copyFile(from, to, dir);
+		free(from);
+		free(to);
+	}
+	char *temp, *path = cachePath(dir, name, ".result");
+	FILE *file = ok ? openTemp(dir, &temp) : NULL;
+	if(file){
+		fprintf(file, "%d %u %.17g %.17g %.17g %.17g %d %d\n", CACHE_VERSION, r->nodes, r->initial_delay, r->original_area,
+			r->optimized_area, r->worst_slack, binary, verified);
+		ok = publish(file, temp, path);
+	}
+	if(!ok || !file) printf("Warning: cannot store %s in the cache %s\n", input, dir);
+	free(path);
+	free(name);
+}
+
+//***********************************************************
+// cones
+static int coneInside(timing_graph *g, int i){
+	// a NAND or shared inverter with one fanout is sized inside its fanout's cone
+	return (g->type[i] == GATE || g->type[i] == INVERTER) && FANOUT_NUM(g, i) == 1;
+}
+
+static int coneRoot(timing_graph *g, int i){
+	return g->type[i] != PI && g->fanin0[i] >= 0 && !coneInside(g, i);
+}
+
+static unsigned long long *nodeHashes(timing_graph *g){
+	// structural hash of every node's fanin cone
+	unsigned long long *h = malloc(g->n * sizeof(unsigned long long));
+	if(!h){
+		printf("Error: out of memory for the cone cache\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < g->n; i++){
+		h[i] = hashMix(g->type[i], g->compl[i]);
+		if(g->type[i] == PI) h[i] = hashText(h[i], g->name[i]);
+		else if(g->fanin0[i] >= 0) h[i] = hashMix(h[i], h[g->fanin0[i]]);
+		if(g->type[i] == GATE && g->fanin1[i] >= 0) h[i] = hashMix(h[i], h[g->fanin1[i]]);
+	}
+	return h;
+}
+
+static int coneNodes(timing_graph *g, int root, const unsigned long long *h, int *order, unsigned long long *key){
+	// nodes of root's cone, root first, and the cone's key; returns the node count
+	int n = 0, top = 0;
+	int *stack = order + g->n;
+	stack[top++] = root;
+	*key = hashMix(h[root], FANOUT_NUM(g, root));
+	while(top > 0){
+		int i = stack[--top];
+		order[n++] = i;
+		*key = hashMix(*key, h[i]);
+		for(int pin = 0; pin < (g->type[i] == GATE ? 2 : 1); pin++){
+			int in = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			if(coneInside(g, in)) stack[top++] = in;
+		}
+	}
+	*key = hashMix(*key, n);
+	return n;
+}
+
+typedef struct cone_entry{
+	unsigned long long key;
+	long cells;	// offset of the cone's cells (nand, inv0, inv1 per node) in the table
+	int n;
+} cone_entry;
+
+static int coneCompare(const void *a, const void *b){
+	const cone_entry *x = a, *y = b;
+	return (x->key > y->key) - (x->key < y->key);
+}
+
+void cacheStoreCones(const char *dir, timing_graph *g, const char *input, unsigned long long context){
+	// the cells of every cone of the sized g as input's cones, context: what the cell ids depend on
+	mkdir(dir, 0777);
+	char *temp, *path = conesPath(dir, input, context);
+	FILE *file = openTemp(dir, &temp);
+	if(!file){
+		printf("Warning: cannot store %s in the cache %s\n", path, dir);
+		free(path);
+		return;
+	}
+	unsigned long long *h = nodeHashes(g);
+	int *order = malloc(2 * (size_t)g->n * sizeof(int));
+	short *cells = malloc(3 * (size_t)g->n * sizeof(short));
+	unsigned int version = CACHE_VERSION, cones = 0;
+	for(unsigned int i = 0; i < g->n; i++) cones += coneRoot(g, i);
+	fwrite(CONES_MAGIC, 1, 4, file);
+	fwrite(&version, sizeof(version), 1, file);
+	fwrite(&context, sizeof(context), 1, file);
+	fwrite(&cones, sizeof(cones), 1, file);
+	for(unsigned int root = 0; root < g->n; root++){
+		if(!coneRoot(g, root)) continue;
+		unsigned long long key;
+		int n = coneNodes(g, root, h, order, &key);
+		for(int k = 0; k < n; k++){
+			cells[3*k] = g->nand_id[order[k]];
+			cells[3*k + 1] = g->inv0_id[order[k]];
+			cells[3*k + 2] = g->inv1_id[order[k]];
+		}
+		fwrite(&key, sizeof(key), 1, file);
+		fwrite(&n, sizeof(n), 1, file);
+		fwrite(cells, sizeof(short), 3 * n, file);
+	}
+	if(!publish(file, temp, path)) printf("Warning: cannot store %s in the cache %s\n", path, dir);
+	free(h);
+	free(order);
+	free(cells);
+	free(path);
+}
+
+static short *readCones(const char *path, unsigned long long context, cone_entry **entry, unsigned int *cones){
+	// the cone table of path sorted by key and its cells, NULL: none for this context
+	FILE *file = fopen(path, "rb");
+	if(!file) return NULL;
+	char magic[4];
+	unsigned int version = 0;
+	unsigned long long stored = 0;
+	*cones = 0;
+	int ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, CONES_MAGIC, 4) == 0 && fread(&version, sizeof(version), 1, file) == 1 &&
+		version == CACHE_VERSION && fread(&stored, sizeof(stored), 1, file) == 1 && stored == context &&
+		fread(cones, sizeof(*cones), 1, file) == 1;
+	*entry = ok ? malloc(max(*cones, 1u) * sizeof(cone_entry)) : NULL;
+	short *cells = NULL;
+	long ncells = 0, cap = 0;
+	for(unsigned int c = 0; ok && c < *cones; c++){
+		cone_entry *e = &(*entry)[c];
+		ok = fread(&e->key, sizeof(e->key), 1, file) == 1 && fread(&e->n, sizeof(e->n), 1, file) == 1 && e->n > 0;
+		if(!ok) break;
+		if(ncells + 3L * e->n > cap){
+			cap = max(2 * cap, ncells + 3L * e->n) + 4096;
+			cells = realloc(cells, cap * sizeof(short));
+			if(!cells){
+				printf("Error: out of memory for the cone cache\n");
+				exit(1);
+			}
+		}
+		e->cells = ncells;
+		ok = fread(cells + ncells, sizeof(short), 3 * e->n, file) == (size_t)(3 * e->n);
+		ncells += 3L * e->n;
+	}
+	fclose(file);
+	if(!ok){
+		free(*entry);
+		free(cells);
+		return NULL;
+	}
+	qsort(*entry, *cones, sizeof(cone_entry), coneCompare);
+	return cells ? cells : malloc(1);
+}
+
+static int validCells(timing_graph *g, int i, const short *c){
+	// stored cells fit node i: a NAND for a NAND, an inverter on every inverted pin
+	if(g->type[i] == GATE && (c[0] < 0 || c[0] >= (int)nand_count)) return 0;
+	if(COMPL0(g, i) && (c[1] < 0 || c[1] >= (int)inv_count)) return 0;
+	if(g->type[i] == GATE && COMPL1(g, i) && (c[2] < 0 || c[2] >= (int)inv_count)) return 0;
+	return 1;
+}
+
+int cacheSeedCones(const char *dir, timing_graph *g, const char *input, unsigned long long context, double target){
+	// after initialDelay(): the stored cells of input's unchanged cones, kept if g then meets
+	// target with times for target, else the fastest cells back; returns the cones reused
+	char *path = conesPath(dir, input, context);
+	cone_entry *entry = NULL;
+	unsigned int cones = 0;
+	short *stored = readCones(path, context, &entry, &cones);
+	free(path);
+	if(!stored) return 0;
+
+	unsigned long long *h = nodeHashes(g);
+	int *order = malloc(2 * (size_t)g->n * sizeof(int));
+	short *fastest = malloc(3 * (size_t)g->n * sizeof(short));
+	if(!order || !fastest){
+		printf("Error: out of memory for the cone cache\n");
+		exit(1);
+	}
+	memcpy(fastest, g->nand_id, g->n * sizeof(short));
+	memcpy(fastest + g->n, g->inv0_id, g->n * sizeof(short));
+	memcpy(fastest + 2 * (size_t)g->n, g->inv1_id, g->n * sizeof(short));
+	int reused = 0;
+	for(unsigned int root = 0; root < g->n; root++){
+		if(!coneRoot(g, root)) continue;
+		cone_entry key;
+		int n = coneNodes(g, root, h, order, &key.key);
+		cone_entry *e = bsearch(&key, entry, cones, sizeof(cone_entry), coneCompare);
+		if(!e || e->n != n) continue;
+		const short *c = stored + e->cells;
+		int ok = 1;
+		for(int k = 0; ok && k < n; k++) ok = validCells(g, order[k], c + 3*k);
+		if(!ok) continue;
+		for(int k = 0; k < n; k++){
+			int i = order[k];
+			if(g->type[i] == GATE) g->nand_id[i] = c[3*k];
+			if(COMPL0(g, i)) g->inv0_id[i] = c[3*k + 1];
+			if(g->type[i] == GATE && COMPL1(g, i)) g->inv1_id[i] = c[3*k + 2];
+		}
+		reused++;
+	}
+	if(reused > 0){
+		staFull(g, target);
+		double tolerance = 1e-9 * target;
+		for(unsigned int i = 0; i < g->n && reused > 0; i++){
+			if(g->type[i] == PO && g->fanin0[i] >= 0 && g->arrival[i] > PO_REQUIRED(g, i, target) + tolerance) reused = 0;
+		}
+		if(reused == 0){
+			memcpy(g->nand_id, fastest, g->n * sizeof(short));
+			memcpy(g->inv0_id, fastest + g->n, g->n * sizeof(short));
+			memcpy(g->inv1_id, fastest + 2 * (size_t)g->n, g->n * sizeof(short));
+			staFull(g, target);
+		}
+	}
+	free(h);
+	free(order);
+	free(fastest);
+	free(entry);
+	free(stored);
+	return reused;
+}
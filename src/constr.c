@@ -0,0 +1,268 @@
+#include "ace.h"
+
+// Timing constraints (--constraints, --target). A constraints file holds one
+// statement per line, # starts a comment:
+//   target T              required time of the outputs: a time, or Fx for F
+//                         times the fastest delay (default 1x, as without a file)
+//   arrival PI T          arrival time of an input (default 0)
+//   required PO T         required time of one output, instead of the target
+//   corner NAME I S [T]   a library corner with cell delays I * intrinsic +
+//                         S * slope * load and its own target (time or Fx)
+// The circuit is sized at the nominal library, corner 0. With more corners,
+// every corner is timed in one vector pass (staCorners()) once the circuit is
+// sized; outputs late at some corner get a proportionally earlier nominal
+// required time and the circuit is sized again, up to CORNER_ROUNDS runs.
+// Outputs even the fastest cells cannot get to their required time are
+// relaxed to their fastest arrival, so the sizers always start feasible.
+
+void defaultConstraints(timing_constraints *c){
+	// the fastest delay as the target, no port times, the nominal corner only
+	memset(c, 0, sizeof(*c));
+	c->target = 1.0;
+	c->relative = 1;
+	c->ncorners = 1;
+	c->corner[0].name = strdup("nominal");
+	c->corner[0].intrinsic = 1.0;
+	c->corner[0].slope = 1.0;
+}
+
+int parseTarget(const char *s, double *target, int *relative){
+	// "T" or "Fx", returns 0 unless s is a positive time or factor
+	char *end;
+	double v = strtod(s, &end);
+	int x = *end == 'x';
+	if(end == s || end[x] != '\0' || !(v > 0.0)) return 0;
+	*target = v;
+	*relative = x;
+	return 1;
+}
+
+int parseSweep(const char *s, double *lo, double *hi, double *step, int *relative){
+	// "lo:hi:step", lo and hi both times or both factors (Fx), step in their unit (the x optional)
+	char text[256], *colon[2];
+	if(strlen(s) >= sizeof(text)) return 0;
+	strcpy(text, s);
+	colon[0] = strchr(text, ':');
+	colon[1] = colon[0] ? strchr(colon[0] + 1, ':') : NULL;
+	if(!colon[1]) return 0;
+	*colon[0] = *colon[1] = '\0';
+	int hi_relative, step_relative;
+	if(!parseTarget(text, lo, relative) || !parseTarget(colon[0] + 1, hi, &hi_relative) ||
+	   !parseTarget(colon[1] + 1, step, &step_relative)) return 0;
+	return hi_relative == *relative && (step_relative == *relative || !step_relative) && *lo <= *hi;
+}
+
+static int parseNumber(const char *s, double *v){
+	char *end;
+	*v = strtod(s, &end);
+	return end != s && *end == '\0';
+}
+
+static int portCompare(const void *a, const void *b){
+	const timing_port *x = a, *y = b;
+	int c = strcmp(x->name, y->name);
+	return c ? c : x->output - y->output;
+}
+
+int readConstraints(timing_constraints *c, const char *file_name){
+	// adds the statements of file_name to c, returns 0 on an error
+	FILE *file = fopen(file_name, "r");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		return 0;
+	}
+	char line[1024];
+	int cap = c->nports, line_no = 0, ok = 1;
+	while(ok && fgets(line, sizeof(line), file)){
+		line_no++;
+		char *hash = strchr(line, '#');
+		if(hash) *hash = '\0';
+		char *tok[6], *save;
+		int n = 0;
+		for(char *t = strtok_r(line, " \t\r\n", &save); t && n < 6; t = strtok_r(NULL, " \t\r\n", &save)) tok[n++] = t;
+		if(n == 0) continue;
+		if(strcmp(tok[0], "target") == 0 && n == 2){
+			ok = parseTarget(tok[1], &c->target, &c->relative);
+		}else if((strcmp(tok[0], "arrival") == 0 || strcmp(tok[0], "required") == 0) && n == 3){
+			double t;
+			ok = parseNumber(tok[2], &t);
+			if(ok){
+				if(c->nports == cap){
+					cap = cap * 2 + 16;
+					c->ports = realloc(c->ports, cap * sizeof(timing_port));
+				}
+				timing_port *p = &c->ports[c->nports++];
+				p->name = strdup(tok[1]);
+				p->output = tok[0][0] == 'r';
+				p->time = t;
+			}
+		}else if(strcmp(tok[0], "corner") == 0 && (n == 4 || n == 5) && c->ncorners < CORNER_MAX){
+			timing_corner *k = &c->corner[c->ncorners];
+			k->target = 0.0;
+			k->relative = 0;
+			ok = parseNumber(tok[2], &k->intrinsic) && parseNumber(tok[3], &k->slope) && k->intrinsic > 0.0 &&
+				k->slope > 0.0 && (n == 4 || parseTarget(tok[4], &k->target, &k->relative));
+			if(ok){
+				k->name = strdup(tok[1]);
+				c->ncorners++;
+			}
+		}else{
+			ok = 0;
+		}
+		if(!ok) printf("Error: %s:%d: bad constraint (at most %d corners)\n", file_name, line_no, CORNER_MAX - 1);
+	}
+	fclose(file);
+	qsort(c->ports, c->nports, sizeof(timing_port), portCompare);
+	return ok;
+}
+
+unsigned long long constraintsHash(const timing_constraints *c){
+	// NULL: no constraints
+	if(!c) return 0;
+	unsigned long long h = hashMix(hashDouble(c->relative, c->target), c->nports);
+	for(int k = 0; k < c->nports; k++){
+		h = hashMix(hashText(h, c->ports[k].name), c->ports[k].output);
+		h = hashDouble(h, c->ports[k].time);
+	}
+	for(int k = 0; k < c->ncorners; k++){
+		h = hashText(h, c->corner[k].name);
+		h = hashDouble(hashDouble(h, c->corner[k].intrinsic), c->corner[k].slope);
+		h = hashMix(hashDouble(h, c->corner[k].target), c->corner[k].relative);
+	}
+	return h;
+}
+
+void freeConstraints(timing_constraints *c){
+	for(int k = 0; k < c->nports; k++) free(c->ports[k].name);
+	free(c->ports);
+	for(int k = 0; k < c->ncorners; k++) free(c->corner[k].name);
+	memset(c, 0, sizeof(*c));
+}
+
+static void portTimes(timing_graph *g){
+	// unconstrained port times: PIs arrive at 0, POs are required at the target
+	if(g->port_time) return;
+	g->port_time = malloc(g->n * sizeof(double));
+	if(!g->port_time){
+		printf("Error: out of memory for port times\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < g->n; i++) g->port_time[i] = g->type[i] == PO ? NAN : 0.0;
+}
+
+int constrainPorts(timing_graph *g, const timing_constraints *c){
+	// port times of g from c, before initialDelay(); returns the ports of c not in g
+	if(c->nports == 0) return 0;
+	portTimes(g);
+	int found = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if((g->type[i] != PI && g->type[i] != PO) || !g->name[i]) continue;
+		timing_port key = {g->name[i], g->type[i] == PO, 0.0};
+		timing_port *p = bsearch(&key, c->ports, c->nports, sizeof(timing_port), portCompare);
+		if(!p) continue;
+		g->port_time[i] = p->time;
+		if(g->type[i] == PI) g->arrival[i] = p->time;
+		found++;
+	}
+	return c->nports - found;
+}
+
+double constraintTarget(const timing_constraints *c, double fastest){
+	return c->relative ? c->target * fastest : c->target;
+}
+
+int relaxRequired(timing_graph *g, double target){
+	// after initialDelay(): outputs the fastest cells get to after their required time are
+	// required at their fastest arrival instead, returns how many
+	int relaxed = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO || g->fanin0[i] < 0 || g->arrival[i] <= PO_REQUIRED(g, i, target)) continue;
+		portTimes(g);
+		g->port_time[i] = g->arrival[i];
+		relaxed++;
+	}
+	return relaxed;
+}
+
+//***********************************************************
+// corners
+void cornerStart(corner_timing *ct, timing_graph *g, const timing_constraints *c, double target, double fastest){
+	// with the fastest cells of initialDelay(): corner targets from the corners' fastest delays
+	memset(ct, 0, sizeof(*ct));
+	if(c->ncorners < 2) return;
+	int nc = ct->nc = c->ncorners;
+	ct->arrival = malloc((size_t)g->n * nc * sizeof(double));
+	ct->required = malloc((size_t)g->n * nc * sizeof(double));
+	ct->po_required = malloc((size_t)g->n * nc * sizeof(double));
+	ct->po_fastest = malloc(g->n * sizeof(double));
+	if(!ct->arrival || !ct->required || !ct->po_required || !ct->po_fastest){
+		printf("Error: out of memory for %d corners\n", nc);
+		exit(1);
+	}
+	memcpy(ct->po_fastest, g->arrival, g->n * sizeof(double));
+	if(g->port_time){
+		ct->port = malloc(g->n * sizeof(double));
+		memcpy(ct->port, g->port_time, g->n * sizeof(double));
+	}
+	staCorners(g, c->corner, nc, ct->port, NULL, ct->arrival, NULL);
+	for(int k = 0; k < nc; k++){
+		double corner_fastest = 0.0;
+		for(unsigned int i = 0; i < g->n; i++){
+			if(g->type[i] == PO) corner_fastest = max(corner_fastest, ct->arrival[(size_t)i * nc + k]);
+		}
+		const timing_corner *corner = &c->corner[k];
+		if(k == 0) ct->target[k] = target;
+		else if(corner->target > 0.0) ct->target[k] = corner->relative ? corner->target * corner_fastest : corner->target;
+		// without its own target a corner keeps the nominal margin, or the absolute target
+		else ct->target[k] = c->relative ? corner_fastest * target / fastest : target;
+	}
+	// like relaxRequired() per corner: no output is required before its fastest arrival there
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO) continue;
+		double *r = ct->po_required + (size_t)i * nc;
+		const double *a = ct->arrival + (size_t)i * nc;
+		for(int k = 0; k < nc; k++) r[k] = max(ct->port && !isnan(ct->port[i]) ? ct->port[i] : ct->target[k], a[k]);
+	}
+}
+
+int cornerCheck(corner_timing *ct, timing_graph *g, const timing_constraints *c, int verbose, int tighten){
+	// time every corner of the sized circuit; with tighten, outputs late at a corner get an
+	// earlier nominal required time (never before their fastest arrival). Returns the outputs tightened
+	int nc = ct->nc;
+	staCorners(g, c->corner, nc, ct->port, ct->po_required, ct->arrival, ct->required);
+	double worst[CORNER_MAX];
+	for(int k = 0; k < nc; k++) worst[k] = DBL_MAX;
+	int tightened = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO || g->fanin0[i] < 0) continue;
+		const double *a = ct->arrival + (size_t)i * nc, *r = ct->required + (size_t)i * nc;
+		double scale = 1.0;
+		for(int k = 0; k < nc; k++){
+			worst[k] = min(worst[k], r[k] - a[k]);
+			if(k > 0 && a[k] > r[k] && a[k] > 0.0) scale = min(scale, r[k] / a[k]);
+		}
+		if(!tighten || scale >= 1.0) continue;
+		double required = max(g->arrival[i] * scale, ct->po_fastest[i]);
+		if(required < PO_REQUIRED(g, i, g->initial_delay) - 1e-9 * g->initial_delay){
+			portTimes(g);
+			g->port_time[i] = required;
+			tightened++;
+		}
+	}
+	if(verbose){
+		for(int k = 0; k < nc; k++){
+			printf("corner %s: target %.3f worst_slack %.3f\n", c->corner[k].name, ct->target[k], FIX_NEG_ZERO(worst[k]));
+		}
+		if(tightened) printf("corners: %d outputs tightened, sizing again\n", tightened);
+	}
+	return tightened;
+}
+
+void cornerFree(corner_timing *ct){
+	free(ct->port);
+	free(ct->po_required);
+	free(ct->po_fastest);
+	free(ct->arrival);
+	free(ct->required);
+	memset(ct, 0, sizeof(*ct));
+}
@@ -0,0 +1,296 @@
+#include "ace.h"
+
+// Shared inverters (--share-inv). mapping() leaves one inverter on every
+// complemented fanin edge, so a net read inverted by ten gates gets ten
+// inverters, each timed at a load of one. shareInverters() rebuilds the graph
+// with one INVERTER node per net read inverted, timed and sized against its
+// real fanout. With a fanout limit (--buffer-fanout) a net driving more sinks
+// of one polarity is split by an inverter-pair tree: the limit-1 sinks with
+// the longest paths behind them stay on the driver, the rest hang off pairs
+// of inverters, recursively, so no node drives more than the limit.
+// New nodes are created when their first sink is built, which keeps the
+// node order topological.
+
+typedef struct share_state{
+	timing_graph *old;
+	timing_graph *g;	// the graph being built
+	int *map;	// old node -> new node
+	int *src;	// src[2*old + pin]: new driver of that fanin edge / -1: not connected yet
+	int *height;	// old node: longest path to a PO in edges
+	int limit;	// fanout limit, INT_MAX: no trees
+	int *edges;	// scratch: 2*node + pin of the sinks of one net
+	int *slots;
+} share_state;
+
+static int addInverter(share_state *s, int driver){
+	// an INVERTER node reading driver, its cell is in inv0_id
+	return graphAddNode(s->g, INVERTER, driver, -1, 1, NULL);
+}
+
+static void buildTree(share_state *s, int base, int n, int *slots){
+	// drivers with base's polarity for n sinks, at most limit sinks per node
+	if(n <= s->limit){
+		for(int k = 0; k < n; k++) slots[k] = base;
+		return;
+	}
+	int direct = s->limit - 1; // the last load of base is the tree
+	for(int k = 0; k < direct; k++) slots[k] = base;
+	int rest = n - direct;
+	int leaves = (rest + s->limit - 1) / s->limit;
+	int *mid = malloc(leaves * sizeof(int));
+	buildTree(s, addInverter(s, base), leaves, mid);
+	for(int l = 0; l < leaves; l++){
+		int leaf = addInverter(s, mid[l]);
+		for(int k = direct + l * s->limit; k < min(n, direct + (l + 1) * s->limit); k++) slots[k] = leaf;
+	}
+	free(mid);
+}
+
+static __thread const int *edge_height; // heights seen by edgeCompare()
+
+static int edgeCompare(const void *a, const void *b){
+	// sinks with the longest path behind them first, then node order
+	const int *height = edge_height;
+	int x = *(const int *)a, y = *(const int *)b;
+	if(height[x >> 1] != height[y >> 1]) return height[y >> 1] - height[x >> 1];
+	return x - y;
+}
+
+static void connectNet(share_state *s, int j, int inverted){
+	// build the drivers of every sink of net j read with this polarity
+	timing_graph *old = s->old;
+	int n = 0;
+	for(int k = old->fanout_start[j]; k < old->fanout_start[j+1]; k++){
+		int fo = old->fanout[k];
+		// a node reading j on both pins is listed twice, take each pin once
+		if(k > old->fanout_start[j] && old->fanout[k - 1] == fo) continue;
+		if(old->fanin0[fo] == j && COMPL0(old, fo) == inverted) s->edges[n++] = 2 * fo;
+		if(old->type[fo] != PO && old->fanin1[fo] == j && COMPL1(old, fo) == inverted) s->edges[n++] = 2 * fo + 1;
+	}
+	edge_height = s->height;
+	qsort(s->edges, n, sizeof(int), edgeCompare);
+	int base = inverted ? addInverter(s, s->map[j]) : s->map[j];
+	buildTree(s, base, n, s->slots);
+	for(int k = 0; k < n; k++) s->src[s->edges[k]] = s->slots[k];
+}
+
+void shareInverters(timing_graph *g, int limit){
+	// after mapping(): one inverter per inverted net, nets split above limit sinks (0: no limit)
+	timing_graph h;
+	memset(&h, 0, sizeof(h));
+	graphReserve(&h, g->n + g->n / 4 + 16);
+	share_state s = {g, &h};
+	s.limit = limit >= 2 ? limit : INT_MAX;
+	s.map = malloc(g->n * sizeof(int));
+	s.src = malloc(2 * g->n * sizeof(int));
+	s.height = malloc(g->n * sizeof(int));
+	s.edges = malloc((g->fanout_start[g->n] + 1) * sizeof(int));
+	s.slots = malloc((g->fanout_start[g->n] + 1) * sizeof(int));
+	if(!s.map || !s.src || !s.height || !s.edges || !s.slots){
+		printf("Error: out of memory for inverter sharing\n");
+		exit(1);
+	}
+	memset(s.src, -1, 2 * g->n * sizeof(int));
+	for(int i = g->n - 1; i >= 0; i--){
+		s.height[i] = 0;
+		for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++) s.height[i] = max(s.height[i], s.height[g->fanout[k]] + 1);
+	}
+
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			// PIs and constant outputs are copied as they are
+			s.map[i] = graphAddNode(&h, g->type[i], -1, -1, g->compl[i], g->name[i]);
+			g->name[i] = NULL;
+			continue;
+		}
+		int pins = g->type[i] == PO ? 1 : 2;
+		int fanin[2] = {-1, -1};
+		for(int pin = 0; pin < pins; pin++){
+			int j = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			if(s.src[2 * i + pin] < 0) connectNet(&s, j, pin == 0 ? COMPL0(g, i) : COMPL1(g, i));
+			fanin[pin] = s.src[2 * i + pin];
+		}
+		s.map[i] = graphAddNode(&h, g->type[i], fanin[0], fanin[1], 0, g->name[i]);
+		g->name[i] = NULL;
+		PROF_COUNT(PROF_INV_REMOVED, COMPL0(g, i) + (pins == 2 ? COMPL1(g, i) : 0));
+	}
+	PROF_COUNT(PROF_INV_ADDED, h.n - g->n);
+
+	free(s.map);
+	free(s.src);
+	free(s.height);
+	free(s.edges);
+	free(s.slots);
+	graphFree(g);
+	*g = h;
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
+}
+
+//***********************************************************
+// polarity assignment (--polarity)
+// With NAND2 and INV cells the output phase of an AND node is fixed, NAND(x, y)
+// is its only one-cell realization, so the inverters mapping() places follow
+// from the AIG alone. XOR is where the phase is free: XOR(x, y) = XOR(!x, !y).
+// The sum-of-products pair NAND(NAND(x^a, y^b), NAND(x^!a, y^!b)) always pays
+// an inverter on one phase of each input; assignPolarity() rebuilds it as the
+// four-NAND XOR, which reads x and y as they are, and pushes a remaining phase
+// difference into the readers of the output by toggling their inverters.
+// A rewrite is kept when it saves area at the smallest cells and, timed with
+// the fastest cells as initialDelay() does, no path through it ends later than
+// the required time of the original mapping, so the delay constraint can
+// only get tighter. The extra NAND level is slower than the inverter it
+// replaces, so a rewrite may also use only part of the XOR's slack: the rest is
+// what the sizer needs to shrink the cells around it.
+
+#define POLARITY_SLACK_USE 0.1	// share of an XOR's slack its rewrite may use
+
+static double nandFast(int load){
+	return NAND_DELAY(load, libt.nand_fastest[load]);
+}
+
+static double fastArrival(timing_graph *g, const double *arrival, int i, double inv){
+	// arrival of node i with the fastest cells
+	if(g->type[i] == PI || g->fanin0[i] < 0) return 0.0;
+	double a0 = arrival[g->fanin0[i]] + (COMPL0(g, i) ? inv : 0.0);
+	if(g->type[i] == PO) return a0;
+	double a1 = arrival[g->fanin1[i]] + (COMPL1(g, i) ? inv : 0.0);
+	return max(a0, a1) + nandFast(FANOUT_NUM(g, i));
+}
+
+static int xorPattern(timing_graph *g, int o, const char *role, int *flip){
+	// o = NAND(u, v) with u = NAND(x^a, y^b) and v = NAND(x^!a, y^!b) private to o,
+	// o's output is XNOR(x, y)^a^b, flip: the four-NAND XOR(x, y) needs an inverted output
+	if(g->type[o] != GATE || g->compl[o] != 0) return 0;
+	int u = g->fanin0[o], v = g->fanin1[o];
+	if(u == v || g->type[u] != GATE || g->type[v] != GATE || role[u] || role[v]) return 0;
+	if(FANOUT_NUM(g, u) != 1 || FANOUT_NUM(g, v) != 1) return 0;
+	int x = g->fanin0[u], y = g->fanin1[u];
+	if(x == y) return 0;
+	int a = COMPL0(g, u), b = COMPL1(g, u);
+	if(g->fanin0[v] == x && g->fanin1[v] == y){
+		if(COMPL0(g, v) == a || COMPL1(g, v) == b) return 0;
+	}else if(g->fanin0[v] == y && g->fanin1[v] == x){
+		if(COMPL0(g, v) == b || COMPL1(g, v) == a) return 0;
+	}else{
+		return 0;
+	}
+	*flip = a == b;
+	return 1;
+}
+
+int assignPolarity(timing_graph *g){
+	// after mapping(), before shareInverters(), the library held by libUse(): returns the XORs rebuilt
+	if(inv_count == 0 || nand_count == 0) return 0;
+	unsigned int n = g->n;
+	double inv = invDelay(libt.inv_fastest[1]);
+	double eps = 1e-9;
+	double *arrival = malloc(n * sizeof(double));
+	double *required = malloc(n * sizeof(double));
+	char *role = calloc(n, 1);	// 1: rebuilt XOR output, 2: NAND absorbed into it
+	if(!arrival || !required || !role){
+		printf("Error: out of memory for polarity assignment\n");
+		exit(1);
+	}
+
+	// fastest-cell timing of the mapping as it is
+	double target = 0.0;
+	for(unsigned int i = 0; i < n; i++){
+		arrival[i] = fastArrival(g, arrival, i, inv);
+		required[i] = DBL_MAX;
+		if(g->type[i] == PO) target = max(target, arrival[i]);
+	}
+	for(int i = n - 1; i >= 0; i--){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		if(g->type[i] == PO) required[i] = target;
+		double base = required[i] - (g->type[i] == PO ? 0.0 : nandFast(FANOUT_NUM(g, i)));
+		required[g->fanin0[i]] = min(required[g->fanin0[i]], base - (COMPL0(g, i) ? inv : 0.0));
+		if(g->type[i] == PO) continue;
+		required[g->fanin1[i]] = min(required[g->fanin1[i]], base - (COMPL1(g, i) ? inv : 0.0));
+	}
+
+	// XORs in topological order, arrivals follow the rewrites made so far
+	int rebuilt = 0;
+	double inv_area = inverters[0].area, nand_area = nands[0].area; // smallest cells, tables are sorted by area
+	for(unsigned int i = 0; i < n; i++){
+		int flip;
+		if(!xorPattern(g, i, role, &flip)){
+			arrival[i] = fastArrival(g, arrival, i, inv);
+			continue;
+		}
+		int u = g->fanin0[i];
+		double t = max(arrival[g->fanin0[u]], arrival[g->fanin1[u]]) + nandFast(2);
+		double out = t + nandFast(1) + nandFast(FANOUT_NUM(g, i));
+		double slack = required[i] - fastArrival(g, arrival, i, inv);
+		int ok = out <= required[i] - (1.0 - POLARITY_SLACK_USE) * slack + eps;
+		int added = 0, removed = 2;
+		for(int k = g->fanout_start[i]; ok && flip && k < g->fanout_start[i+1]; k++){
+			int fo = g->fanout[k];
+			if(k > g->fanout_start[i] && g->fanout[k - 1] == fo) continue;
+			for(int pin = 0; pin < (g->type[fo] == PO ? 1 : 2); pin++){
+				if((pin == 0 ? g->fanin0[fo] : g->fanin1[fo]) != i) continue;
+				if(pin == 0 ? COMPL0(g, fo) : COMPL1(g, fo)){
+					removed++;
+					continue;
+				}
+				added++;
+				double delay = g->type[fo] == PO ? 0.0 : nandFast(FANOUT_NUM(g, fo));
+				if(out + inv + delay > required[fo] + eps) ok = 0;
+			}
+		}
+		if(!ok || nand_area + (added - removed) * inv_area >= -eps){
+			arrival[i] = fastArrival(g, arrival, i, inv);
+			continue;
+		}
+		if(flip){
+			for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+				int fo = g->fanout[k];
+				if(k > g->fanout_start[i] && g->fanout[k - 1] == fo) continue;
+				if(g->fanin0[fo] == i) g->compl[fo] ^= 1;
+				if(g->type[fo] != PO && g->fanin1[fo] == i) g->compl[fo] ^= 2;
+			}
+		}
+		role[i] = 1;
+		role[u] = role[g->fanin1[i]] = 2;
+		arrival[i] = out;
+		rebuilt++;
+		PROF_COUNT(PROF_INV_REMOVED, removed);
+		PROF_COUNT(PROF_INV_ADDED, added);
+	}
+	free(arrival);
+	free(required);
+	if(rebuilt == 0){
+		free(role);
+		return 0;
+	}
+
+	// rebuild with the absorbed NANDs dropped, the four NANDs of a rewrite take the XOR's place
+	timing_graph h;
+	memset(&h, 0, sizeof(h));
+	graphReserve(&h, n + rebuilt);
+	int *map = malloc(n * sizeof(int));
+	for(unsigned int i = 0; i < n; i++){
+		if(role[i] == 2) continue;
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			map[i] = graphAddNode(&h, g->type[i], -1, -1, g->compl[i], g->name[i]);
+		}else if(role[i] == 1){
+			int u = g->fanin0[i];
+			int x = map[g->fanin0[u]], y = map[g->fanin1[u]];
+			int t = graphAddNode(&h, GATE, x, y, 0, NULL);
+			int a = graphAddNode(&h, GATE, x, t, 0, NULL);
+			int b = graphAddNode(&h, GATE, y, t, 0, NULL);
+			map[i] = graphAddNode(&h, GATE, a, b, 0, g->name[i]);
+		}else{
+			int fanin1 = g->type[i] == PO ? -1 : map[g->fanin1[i]];
+			map[i] = graphAddNode(&h, g->type[i], map[g->fanin0[i]], fanin1, g->compl[i], g->name[i]);
+		}
+		g->name[i] = NULL;
+	}
+	free(map);
+	free(role);
+	graphFree(g);
+	*g = h;
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
+	return rebuilt;
+}
@@ -0,0 +1,394 @@
+#include <pthread.h>
+#include "ace.h"
+
+//***********************************************************
+// static variables
+cell_library cell_lib; // every cell of the library, grouped by function, see sortLib()
+unsigned int inv_count = 0;
+lib_cell *inverters; // cells of the INV function in cell_lib, by increasing area
+unsigned int nand_count = 0;
+lib_cell *nands; // cells of the NAND2 function
+lib_table libt; // delay tables, see characterizeLib()
+
+//***********************************************************
+// library file
+// A cell is its name line followed by keyword lines, up to the next name:
+//   Function !(a&b)     output of pins a..f, with ! ~ & * | + ^ and parentheses
+//   Timing 4.60 0.74    every pin arc: delay = intrinsic + slope * load
+//   Timing b 4.70 0.80  one pin's arc
+//   Area 0.058
+// Cells without a Function line are the original PA3 format: INV* cells are
+// inverters and NAND* cells 2-input NANDs, all size variants of one function.
+
+static const unsigned long long pin_truth[LIB_MAX_PINS] = {
+	// truth table of pin k over the 64 minterms of LIB_MAX_PINS inputs
+	0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+	0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull
+};
+
+typedef struct function_parser{
+	const char *p;
+	int pins;	// highest pin used + 1
+	int error;
+} function_parser;
+
+static unsigned long long parseOr(function_parser *f);
+
+static void skipSpace(function_parser *f){
+	while(*f->p == ' ' || *f->p == '\t') f->p++;
+}
+
+static unsigned long long parseFactor(function_parser *f){
+	skipSpace(f);
+	char c = *f->p;
+	if(c == '!' || c == '~'){
+		f->p++;
+		return ~parseFactor(f);
+	}
+	if(c == '('){
+		f->p++;
+		unsigned long long v = parseOr(f);
+		skipSpace(f);
+		if(*f->p == ')') f->p++;
+		else f->error = 1;
+		return v;
+	}
+	f->p++;
+	if(c == '0') return 0;
+	if(c == '1') return ~0ull;
+	int pin = c >= 'a' && c <= 'z' ? c - 'a' : c - 'A';
+	if(pin < 0 || pin >= LIB_MAX_PINS){
+		f->error = 1;
+		return 0;
+	}
+	f->pins = max(f->pins, pin + 1);
+	return pin_truth[pin];
+}
+
+static unsigned long long parseAnd(function_parser *f){
+	unsigned long long v = parseFactor(f);
+	while(skipSpace(f), *f->p == '&' || *f->p == '*'){
+		f->p++;
+		v &= parseFactor(f);
+	}
+	return v;
+}
+
+static unsigned long long parseXor(function_parser *f){
+	unsigned long long v = parseAnd(f);
+	while(skipSpace(f), *f->p == '^'){
+		f->p++;
+		v ^= parseAnd(f);
+	}
+	return v;
+}
+
+static unsigned long long parseOr(function_parser *f){
+	unsigned long long v = parseXor(f);
+	while(skipSpace(f), *f->p == '|' || *f->p == '+'){
+		f->p++;
+		v |= parseXor(f);
+	}
+	return v;
+}
+
+static unsigned long long truthMask(int pins){
+	return pins >= LIB_MAX_PINS ? ~0ull : (1ull << (1 << pins)) - 1;
+}
+
+typedef struct cell_parser{
+	// the cell being read, added to cell_lib by endCell()
+	int open;
+	lib_cell cell;
+	lib_arc all;	// arc of every pin without its own
+	lib_arc pin[LIB_MAX_PINS];
+	int has_pin[LIB_MAX_PINS];
+	int has_function;
+} cell_parser;
+
+static void *growLib(void *p, int *cap, int need, size_t elem){
+	if(need <= *cap) return p;
+	*cap = max(need, *cap * 2 + 16);
+	p = realloc(p, *cap * elem);
+	if(!p){
+		printf("Error: out of memory for the library\n");
+		exit(1);
+	}
+	return p;
+}
+
+static int endCell(cell_parser *c){
+	// append the parsed cell and its arcs, returns 0 on error
+	if(!c->open) return 1;
+	c->open = 0;
+	lib_cell *cell = &c->cell;
+	if(!c->has_function){
+		if(strstr(cell->name, "INV")){
+			cell->pins = 1;
+			cell->truth = LIB_TRUTH_INV;
+		}else if(strstr(cell->name, "NAND")){
+			cell->pins = 2;
+			cell->truth = LIB_TRUTH_NAND2;
+		}else{
+			printf("Error: library cell %s has no Function\n", cell->name);
+			return 0;
+		}
+	}
+	static int arc_cap = 0, cell_cap = 0;
+	cell_lib.arcs = growLib(cell_lib.arcs, &arc_cap, cell_lib.narcs + cell->pins, sizeof(lib_arc));
+	cell_lib.cells = growLib(cell_lib.cells, &cell_cap, cell_lib.ncells + 1, sizeof(lib_cell));
+	cell->arc = cell_lib.narcs;
+	cell->timing[0] = cell->timing[1] = 0.0;
+	for(int k = 0; k < cell->pins; k++){
+		lib_arc arc = c->has_pin[k] ? c->pin[k] : c->all;
+		cell_lib.arcs[cell_lib.narcs++] = arc;
+		// the per-cell delay model takes the slowest pin
+		cell->timing[0] = max(cell->timing[0], arc.intrinsic);
+		cell->timing[1] = max(cell->timing[1], arc.slope);
+	}
+	cell_lib.cells[cell_lib.ncells++] = *cell;
+	return 1;
+}
+
+int parseLib(){
+	// PA3.lib of the working directory into cell_lib, returns 0 on error
+	char line[256];
+	cell_parser c;
+	memset(&c, 0, sizeof(c));
+	int ok = 1;
+
+	// open file
+	FILE *file = fopen("PA3.lib", "r");
+	if(!file){
+		printf("Error: cannot open PA3.lib\n");
+		return 0;
+	}
+
+	// read file
+	while(fgets(line, sizeof(line), file)){
+		char *comment = strchr(line, '#');
+		if(comment) *comment = '\0';
+		char *token = strtok(line, " \t\r\n");
+		if(token == NULL) continue;
+
+		if(strcmp(token, "Timing") == 0 && c.open){
+			// "Timing intrinsic slope" or "Timing pin intrinsic slope"
+			char *first = strtok(NULL, " \t\r\n");
+			lib_arc *arc = &c.all;
+			if(first && ((first[0] >= 'a' && first[0] <= 'f') || (first[0] >= 'A' && first[0] <= 'F')) && first[1] == '\0'){
+				int pin = first[0] >= 'a' ? first[0] - 'a' : first[0] - 'A';
+				arc = &c.pin[pin];
+				c.has_pin[pin] = 1;
+				first = strtok(NULL, " \t\r\n");
+			}
+			char *second = strtok(NULL, " \t\r\n");
+			arc->intrinsic = first ? atof(first) : 0.0;
+			arc->slope = second ? atof(second) : 0.0;
+		}else if(strcmp(token, "Area") == 0 && c.open){
+			token = strtok(NULL, " \t\r\n");
+			c.cell.area = token ? atof(token) : 0.0;
+		}else if(strcmp(token, "Function") == 0 && c.open){
+			function_parser f = {strtok(NULL, "\r\n"), 0, 0};
+			if(f.p == NULL) f.error = 1;
+			else{
+				c.cell.truth = parseOr(&f);
+				skipSpace(&f);
+				if(*f.p != '\0') f.error = 1;
+			}
+			if(f.error || f.pins == 0){
+				printf("Error: bad Function of library cell %s\n", c.cell.name);
+				ok = 0;
+				break;
+			}
+			c.cell.pins = f.pins;
+			c.cell.truth &= truthMask(f.pins);
+			c.has_function = 1;
+		}else{
+			// token = gate_name
+			if(!(ok = endCell(&c))) break;
+			memset(&c, 0, sizeof(c));
+			c.open = 1;
+			c.cell.name = strdup(token);
+		}
+	}
+	fclose(file);
+	if(!ok || !endCell(&c)) return 0;
+	// the mapped netlist needs both
+	int inv = 0, nand = 0;
+	for(int k = 0; k < cell_lib.ncells; k++){
+		inv |= cell_lib.cells[k].pins == 1 && cell_lib.cells[k].truth == LIB_TRUTH_INV;
+		nand |= cell_lib.cells[k].pins == 2 && cell_lib.cells[k].truth == LIB_TRUTH_NAND2;
+	}
+	if(!inv || !nand){
+		printf("Error: PA3.lib has no %s cell\n", inv ? "NAND2" : "INV");
+		return 0;
+	}
+	return 1;
+}
+
+//***********************************************************
+// function index
+static unsigned int functionHash(int pins, unsigned long long truth, int size){
+	return (unsigned int)((truth * 0x9e3779b97f4a7c15ull) >> 32 ^ pins * 40503u) & (size - 1);
+}
+
+int libFunction(int pins, unsigned long long truth){
+	// function of pins inputs with this truth table, -1 if no cell implements it
+	if(cell_lib.index_size == 0) return -1;
+	truth &= truthMask(pins);
+	unsigned int h = functionHash(pins, truth, cell_lib.index_size);
+	while(cell_lib.index[h] >= 0){
+		lib_function *f = &cell_lib.functions[cell_lib.index[h]];
+		if(f->pins == pins && f->truth == truth) return cell_lib.index[h];
+		h = (h + 1) & (cell_lib.index_size - 1);
+	}
+	return -1;
+}
+
+static int cellCompare(const void *a, const void *b){
+	// by function (order of first appearance), then area, then file order
+	const lib_cell *x = a, *y = b;
+	if(x->function != y->function) return x->function - y->function;
+	if(x->area != y->area) return x->area < y->area ? -1 : 1;
+	return x->arc - y->arc;
+}
+
+void sortLib(){
+	// group the cells by function from small area to large area and index the functions
+	cell_lib.nfunctions = 0;
+	for(int k = 0; k < cell_lib.ncells; k++){
+		lib_cell *cell = &cell_lib.cells[k];
+		int f = 0;
+		while(f < cell_lib.nfunctions && (cell_lib.functions[f].pins != cell->pins || cell_lib.functions[f].truth != cell->truth)) f++;
+		if(f == cell_lib.nfunctions){
+			cell_lib.functions = realloc(cell_lib.functions, (f + 1) * sizeof(lib_function));
+			cell_lib.functions[f] = (lib_function){cell->truth, cell->pins, 0, 0};
+			cell_lib.nfunctions++;
+		}
+		cell->function = f;
+		cell_lib.functions[f].count++;
+	}
+	qsort(cell_lib.cells, cell_lib.ncells, sizeof(lib_cell), cellCompare);
+	for(int k = cell_lib.ncells - 1; k >= 0; k--) cell_lib.functions[cell_lib.cells[k].function].first = k;
+
+	cell_lib.index_size = 16;
+	while(cell_lib.index_size < 2 * cell_lib.nfunctions) cell_lib.index_size *= 2;
+	free(cell_lib.index);
+	cell_lib.index = malloc(cell_lib.index_size * sizeof(int));
+	memset(cell_lib.index, -1, cell_lib.index_size * sizeof(int));
+	for(int f = 0; f < cell_lib.nfunctions; f++){
+		unsigned int h = functionHash(cell_lib.functions[f].pins, cell_lib.functions[f].truth, cell_lib.index_size);
+		while(cell_lib.index[h] >= 0) h = (h + 1) & (cell_lib.index_size - 1);
+		cell_lib.index[h] = f;
+	}
+
+	// the mapped netlist is NAND2 + INV, size ids index these two slices
+	int inv = libFunction(1, LIB_TRUTH_INV), nand = libFunction(2, LIB_TRUTH_NAND2);
+	inverters = inv >= 0 ? &cell_lib.cells[cell_lib.functions[inv].first] : NULL;
+	inv_count = inv >= 0 ? cell_lib.functions[inv].count : 0;
+	nands = nand >= 0 ? &cell_lib.cells[cell_lib.functions[nand].first] : NULL;
+	nand_count = nand >= 0 ? cell_lib.functions[nand].count : 0;
+	if(inv_count > MAX_LIB_CELLS || nand_count > MAX_LIB_CELLS){
+		printf("Error: more than %d cells of one type in library\n", MAX_LIB_CELLS);
+		exit(1);
+	}
+}
+
+static void characterizeKind(lib_cell *cells, int count, int load, double *delay, short *fastest, short *pareto, short *pareto_n){
+	// delay of every cell at this load, the fastest one and the area/delay Pareto front
+	double min_delay = DBL_MAX;
+	int n = 0;
+	fastest[load] = -1;
+	for(int c = 0; c < count; c++){
+		double d = cells[c].timing[0] + cells[c].timing[1]*load;
+		delay[load*count + c] = d;
+		// cells are sorted by area, so a cell is Pareto-optimal iff it beats every smaller one
+		if(min_delay > d){
+			fastest[load] = c;
+			min_delay = d;
+			pareto[load*count + n++] = c;
+		}
+	}
+	pareto_n[load] = n;
+}
+
+void characterizeLib(int max_load){
+	// build delay tables for loads 0 .. max_load, call after sortLib(); grows on demand
+	if(libt.inv_delay && max_load <= libt.max_load) return;
+	int loads = max_load + 1;
+	libt.inv_delay = realloc(libt.inv_delay, loads * max(inv_count, 1) * sizeof(double));
+	libt.nand_delay = realloc(libt.nand_delay, loads * max(nand_count, 1) * sizeof(double));
+	libt.inv_fastest = realloc(libt.inv_fastest, loads * sizeof(short));
+	libt.nand_fastest = realloc(libt.nand_fastest, loads * sizeof(short));
+	libt.inv_pareto = realloc(libt.inv_pareto, loads * max(inv_count, 1) * sizeof(short));
+	libt.nand_pareto = realloc(libt.nand_pareto, loads * max(nand_count, 1) * sizeof(short));
+	libt.inv_pareto_n = realloc(libt.inv_pareto_n, loads * sizeof(short));
+	libt.nand_pareto_n = realloc(libt.nand_pareto_n, loads * sizeof(short));
+	if(!libt.inv_delay || !libt.nand_delay || !libt.inv_fastest || !libt.nand_fastest ||
+	   !libt.inv_pareto || !libt.nand_pareto || !libt.inv_pareto_n || !libt.nand_pareto_n){
+		printf("Error: out of memory for library tables\n");
+		exit(1);
+	}
+	for(int load = 0; load < loads; load++){
+		characterizeKind(inverters, inv_count, load, libt.inv_delay, libt.inv_fastest, libt.inv_pareto, libt.inv_pareto_n);
+		characterizeKind(nands, nand_count, load, libt.nand_delay, libt.nand_fastest, libt.nand_pareto, libt.nand_pareto_n);
+	}
+	libt.max_load = max_load;
+}
+
+static int smallestFit(const double *delay, const short *pareto, int n, double budget){
+	// Pareto delays strictly decrease with area: binary search the first cell with delay <= budget
+	int lo = 0, hi = n, probes = 0;
+	while(lo < hi){
+		int mid = (lo + hi) / 2;
+		if(delay[pareto[mid]] <= budget) hi = mid;
+		else lo = mid + 1;
+		probes++;
+	}
+	PROF_COUNT(PROF_CELLS, probes);
+	return lo < n ? pareto[lo] : -1;
+}
+
+int smallestInv(int load, double budget){
+	// smallest-area inverter with delay <= budget at load / -1: none fits
+	return smallestFit(libt.inv_delay + load*inv_count, libt.inv_pareto + load*inv_count, libt.inv_pareto_n[load], budget);
+}
+
+int smallestNand(int load, double budget){
+	// smallest-area NAND with delay <= budget at load / -1: none fits
+	return smallestFit(libt.nand_delay + load*nand_count, libt.nand_pareto + load*nand_count, libt.nand_pareto_n[load], budget);
+}
+
+unsigned long long libHash(){
+	// the parsed library: every cell with its function, area and arcs, in sorted order
+	unsigned long long h = hashMix(cell_lib.ncells, cell_lib.narcs);
+	for(int k = 0; k < cell_lib.ncells; k++){
+		const lib_cell *cell = &cell_lib.cells[k];
+		h = hashText(h, cell->name);
+		h = hashMix(hashMix(h, cell->truth), cell->pins);
+		h = hashDouble(h, cell->area);
+		for(int pin = 0; pin < cell->pins; pin++){
+			h = hashDouble(h, cell_lib.arcs[cell->arc + pin].intrinsic);
+			h = hashDouble(h, cell_lib.arcs[cell->arc + pin].slope);
+		}
+	}
+	return h;
+}
+
+static pthread_rwlock_t lib_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+void libUse(int max_load){
+	// hold the delay tables for a circuit with loads up to max_load, growing them first if
+	// needed; circuits sized concurrently (--batch) share the tables, release with libDone()
+	pthread_rwlock_rdlock(&lib_lock);
+	if(libt.inv_delay && max_load <= libt.max_load) return;
+	pthread_rwlock_unlock(&lib_lock);
+	pthread_rwlock_wrlock(&lib_lock);
+	characterizeLib(max_load);
+	pthread_rwlock_unlock(&lib_lock);
+	pthread_rwlock_rdlock(&lib_lock);
+}
+
+void libDone(){
+	pthread_rwlock_unlock(&lib_lock);
+}
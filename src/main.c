@@ -1,17 +1,11 @@
-#include <time.h>
-#include <stdio.h>
-#include <string.h>
-#include <malloc.h>
-#include <float.h>
-#include <limits.h>
-#include <stdbool.h>
-#include <math.h>
-#include "base/abc/abc.h"
-
-#define max(a,b) ((a) > (b) ? (a) : (b))
-#define min(a,b) ((a) < (b) ? (a) : (b))
-#define FIX_NEG_ZERO(x) (fabs(x) < 1e-10 ? 0.0 : (x))
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "ace.h"
 
+#ifdef ACE_USE_ABC
 // procedures to start and stop the ABC framework
 // (should be called before and after the ABC procedures are called)
 extern void  Abc_Start();
@@ -19,483 +13,441 @@ extern void  Abc_Stop();
 
 extern void util_getopt_reset ARGS((void));
 extern Abc_Ntk_t * Io_ReadBlifAsAig(char *, int);
-
-// gcc -O3 main.o /home/shangyang/alanmi-abc-906cecc894b2//libabc.a -o ace -lm -ldl -lrt -rdynamic -lreadline -lhistory -ltermcap -lpthread
-
-//***********************************************************
-// structures
-typedef struct lib_gate{
-    char *name;
-    enum {INV, NAND} gate_type;
-    double timing[2]; // timing[0]: fixed timing, timing[1]: timing *= output
-    double area;
-} lib_gate;
-
-typedef struct node{
-	Abc_Obj_t *obj;
-	enum {GATE, PI, PO} type;
-	double delay;	// node output result time
-	double arrival0; // inv0 arrival time
-	double arrival1; // inv1 arrival time	
-	double required_time;	// node required time
-	double slack;	// nand slack
-	double inv_slack0;	// inv0 slack
-	double inv_slack1;	// inv1 slack
-	int inv0_id; // fanin0 using inverter_id in library / -1: no inverter
-	int inv1_id; // fanin1 using inverter_id in library / -1: no inverter
-	int nand_id; // using NAND_id in library / -1: not NAND gate
-	int inv0_gateID; // renaming
-	int inv1_gateID; // renaming
-	int nand_gateID; // renaming				
-	int inputs[2]; // input node index in nodes[]
-} node;
-
-//***********************************************************
-// static variables
-unsigned int node_count = 0;
-node nodes[2500]; // max bench mark: c6288.blif 2401 nodes
-unsigned int inv_count = 0;
-lib_gate inverters[8]; // library data count: 8
-unsigned int nand_count = 0;
-lib_gate nands[8]; // library data count: 8
-double _initial_delay = 0;
-double _original_area = 0;
-double _optimized_area = 0;
-unsigned int _inv = 0; // inverter count
-unsigned int nand = 0; // nand gate count
+#endif
 
 //***********************************************************
 // functions
-void PrintEachObj(Abc_Ntk_t *ntk){
-	Abc_Obj_t *node, *fi;
-	int i, j;
-	
-	printf("<< Print Each Obj- >>\n");
-	printf(" ID       Name  Type  Level\n");
-	printf("--------------------\n");
-	Abc_NtkForEachObj(ntk, node, i){
-		printf("%3d %10s %2d %2d\n", node->Id, Abc_ObjName(node), node->Type, node->Level);
+double wallTime(){
+	// monotonic wall clock in seconds, used for per-phase timing
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-		Abc_ObjForEachFanin(node, fi, j){
-			printf("  %10s %d\n", Abc_ObjName(fi), Abc_ObjFaninC(node, j));
+void mapping(timing_graph *g){
+	// AND to NAND + INV
+	// traverse through all nodes that may have inputs
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI){
+			continue;
 		}
+		// constant outputs keep their value, fanin -1 is skipped below
+		// if input already has INV => add in an INV will make it become redundant INV
+		// if input doesn't have INV => add in an INV will make it become an INV
+		if(g->fanin0[i] >= 0 && g->type[g->fanin0[i]] != PI) g->compl[i] ^= 1;
+		if(g->fanin1[i] >= 0 && g->type[g->fanin1[i]] != PI) g->compl[i] ^= 2;
 	}
-	printf("<< ----- End ----- >>\n");
 }
 
-void parseLib(){
-	char line[20];
-	bool turn = 0; // 0: inv, 1: nand
-
-	// open file
-	FILE *file = fopen("PA3.lib", "r");
-	if(!file){
-		printf("Error: cannot open file\n");
-		return;
+void graphReserve(timing_graph *g, unsigned int cap){
+	// grow every per-node array to hold at least cap nodes
+	if(cap <= g->cap) return;
+	if(cap < 2*g->cap) cap = 2*g->cap;
+	g->type = realloc(g->type, cap * sizeof(*g->type));
+	g->compl = realloc(g->compl, cap * sizeof(*g->compl));
+	g->fanin0 = realloc(g->fanin0, cap * sizeof(*g->fanin0));
+	g->fanin1 = realloc(g->fanin1, cap * sizeof(*g->fanin1));
+	g->arrival = realloc(g->arrival, cap * sizeof(*g->arrival));
+	g->required = realloc(g->required, cap * sizeof(*g->required));
+	g->slack = realloc(g->slack, cap * sizeof(*g->slack));
+	g->inv_slack0 = realloc(g->inv_slack0, cap * sizeof(*g->inv_slack0));
+	g->inv_slack1 = realloc(g->inv_slack1, cap * sizeof(*g->inv_slack1));
+	g->nand_id = realloc(g->nand_id, cap * sizeof(*g->nand_id));
+	g->inv0_id = realloc(g->inv0_id, cap * sizeof(*g->inv0_id));
+	g->inv1_id = realloc(g->inv1_id, cap * sizeof(*g->inv1_id));
+	g->name = realloc(g->name, cap * sizeof(*g->name));
+	g->fanout_start = realloc(g->fanout_start, (cap + 1) * sizeof(*g->fanout_start));
+	if(!g->type || !g->compl || !g->fanin0 || !g->fanin1 || !g->arrival || !g->required || !g->slack || !g->inv_slack0 ||
+	   !g->inv_slack1 || !g->nand_id || !g->inv0_id || !g->inv1_id || !g->name || !g->fanout_start){
+		printf("Error: out of memory for %u nodes\n", cap);
+		exit(1);
 	}
+	g->cap = cap;
+}
 
-	// read file
-	while(fgets(line, sizeof(line), file)){
-		unsigned  len = strlen(line);
-		if(line[len-1] == '\n') line[len-1] = '\0';
+void graphFree(timing_graph *g){
+	staFree(g);
+	free(g->type);
+	free(g->compl);
+	free(g->fanin0);
+	free(g->fanin1);
+	free(g->arrival);
+	free(g->required);
+	free(g->slack);
+	free(g->inv_slack0);
+	free(g->inv_slack1);
+	free(g->nand_id);
+	free(g->inv0_id);
+	free(g->inv1_id);
+	for(unsigned int i = 0; i < g->n; i++) free(g->name[i]);
+	free(g->name);
+	free(g->fanout_start);
+	free(g->fanout);
+	free(g->level_start);
+	free(g->level_nodes);
+	free(g->port_time);
+	memset(g, 0, sizeof(*g));
+}
 
-		char *token = strtok(line, " ");
-		if(token == NULL) continue;
+void graphBuildFanouts(timing_graph *g){
+	// counting pass then fill pass, fanouts of each node end up in topological order
+	unsigned int i;
+	for(i = 0; i <= g->n; i++) g->fanout_start[i] = 0;
+	for(i = 0; i < g->n; i++){
+		if(g->fanin0[i] >= 0) g->fanout_start[g->fanin0[i] + 1]++;
+		if(g->fanin1[i] >= 0) g->fanout_start[g->fanin1[i] + 1]++;
+	}
+	for(i = 0; i < g->n; i++) g->fanout_start[i + 1] += g->fanout_start[i];
 
-		// token = gate_name
-		if(strstr(token, "INV") || strstr(token, "NAND")){
-			lib_gate gate;
-			gate.name = strdup(token);
+	free(g->fanout);
+	g->fanout = malloc((g->fanout_start[g->n] + 1) * sizeof(*g->fanout));
+	int *fill = malloc((g->n + 1) * sizeof(int));
+	if(!g->fanout || !fill){
+		printf("Error: out of memory for fanout list\n");
+		exit(1);
+	}
+	memcpy(fill, g->fanout_start, g->n * sizeof(int));
+	for(i = 0; i < g->n; i++){
+		if(g->fanin0[i] >= 0) g->fanout[fill[g->fanin0[i]]++] = i;
+		if(g->fanin1[i] >= 0) g->fanout[fill[g->fanin1[i]]++] = i;
+	}
+	free(fill);
+}
 
-			if (strstr(token, "INV")){
-				turn = 0;
-				gate.gate_type = INV;
-				inverters[inv_count] = gate;
-			}
-			else{
-				turn = 1;
-				gate.gate_type = NAND;
-				nands[nand_count] = gate;
-			}
-		}
-		else{
-			// token = timing
-			if(strcmp(token, "Timing") == 0){
-				token = strtok(NULL, " ");
-				if(turn == 0){
-					inverters[inv_count].timing[0] = atof(token);
-					token = strtok(NULL, " ");
-					inverters[inv_count].timing[1] = atof(token);
-				}else{
-					nands[nand_count].timing[0] = atof(token);
-					token = strtok(NULL, " ");
-					nands[nand_count].timing[1] = atof(token);		
-				}
-			}
+int graphMaxFanout(timing_graph *g){
+	int max_fanout = 0;
+	for(unsigned int i = 0; i < g->n; i++) max_fanout = max(max_fanout, FANOUT_NUM(g, i));
+	return max_fanout;
+}
 
-			// token = area
-			else{
-				token = strtok(NULL, " ");
-				if(turn == 0){
-					inverters[inv_count].area = atof(token);
-					inv_count++;
-				}else{
-					nands[nand_count].area = atof(token);	
-					nand_count++;
-				}				
-			}
-		}
-		token = strtok(NULL, " ");
+unsigned int graphInverters(timing_graph *g){
+	// inverted fanin edges, the inverters mapping() leaves before any sharing
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		count += COMPL0(g, i) + (g->type[i] == GATE ? COMPL1(g, i) : 0);
 	}
+	return count;
 }
 
-void sortLib(){
-	// sort libraries from small area to large area
-	for(unsigned int i=0; i<inv_count; i++){
-		for(unsigned int j=0; j<i; ++j){
-			if(inverters[j].area > inverters[i].area){
-				lib_gate temp = inverters[j];
-				inverters[j] = inverters[i];
-				inverters[i] =  temp;
-			}
-		}
+double nodeArea(timing_graph *g, int i){
+	// area of the cells node i places in the netlist, as Write() writes them
+	if(g->type[i] == PI || g->fanin0[i] < 0) return 0.0;
+	double area = COMPL0(g, i) && g->inv0_id[i] >= 0 ? inverters[g->inv0_id[i]].area : 0.0;
+	if(g->type[i] != GATE) return area;
+	if(COMPL1(g, i) && g->inv1_id[i] >= 0) area += inverters[g->inv1_id[i]].area;
+	return area + (g->nand_id[i] >= 0 ? nands[g->nand_id[i]].area : 0.0);
+}
+
+double graphArea(timing_graph *g){
+	// total area of the current cells
+	double area = 0.0;
+	for(unsigned int i = 0; i < g->n; i++) area += nodeArea(g, i);
+	return area;
+}
+
+void graphBuildLevels(timing_graph *g){
+	// bucket nodes by logic level (PI = 0), nodes of one level only depend on lower levels
+	staFree(g);	// the timing state follows the structure
+	int *level = malloc((g->n + 1) * sizeof(int));
+	if(!level){
+		printf("Error: out of memory for levels\n");
+		exit(1);
+	}
+	int nlevels = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		level[i] = 0;
+		if(g->fanin0[i] >= 0) level[i] = max(level[i], level[g->fanin0[i]] + 1);
+		if(g->fanin1[i] >= 0) level[i] = max(level[i], level[g->fanin1[i]] + 1);
+		nlevels = max(nlevels, level[i] + 1);
 	}
 
-	for(unsigned int i=0; i<nand_count; i++){
-		for(unsigned int j=0; j<i; ++j){
-			if(nands[j].area > nands[i].area){
-				lib_gate temp = nands[j];
-				nands[j] = nands[i];
-				nands[i] =  temp;
-			}
-		}
+	free(g->level_start);
+	free(g->level_nodes);
+	g->nlevels = nlevels;
+	g->level_start = calloc(nlevels + 1, sizeof(int));
+	g->level_nodes = malloc((g->n + 1) * sizeof(int));
+	if(!g->level_start || !g->level_nodes){
+		printf("Error: out of memory for levels\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < g->n; i++) g->level_start[level[i] + 1]++;
+	for(int l = 0; l < nlevels; l++) g->level_start[l + 1] += g->level_start[l];
+	// counting sort, nodes stay in index order inside a level
+	int *fill = malloc((nlevels + 1) * sizeof(int));
+	if(!fill){
+		printf("Error: out of memory for levels\n");
+		exit(1);
 	}
+	memcpy(fill, g->level_start, nlevels * sizeof(int));
+	for(unsigned int i = 0; i < g->n; i++) g->level_nodes[fill[level[i]]++] = i;
+	free(fill);
+	free(level);
 }
 
-void mapping(Abc_Ntk_t *ntk){
-	// AND to NAND + INV
-	Abc_Obj_t *obj, *fi;
-	int i, j;
-	// traverse through all objects that may have inputs
-	Abc_NtkForEachObj(ntk, obj, i){
-		if (obj->Type == ABC_OBJ_PI){
-			continue;
-		}
-		Abc_ObjForEachFanin(obj, fi, j){
-			if(fi->Type != ABC_OBJ_PI){
-				// if input already has INV => add in an INV will make it become redundant INV
-				// if input doesn't have INV => add in an INV will make it become an INV
-				if (j == 0){
-					obj->fCompl0 = !obj->fCompl0;
-				}else{
-					obj->fCompl1 = !obj->fCompl1;
-				}
-			}
-		}
+int graphAddNode(timing_graph *g, int type, int fanin0, int fanin1, int compl, char *name){
+	// append a node after its fanins, the graph takes ownership of name (may be NULL)
+	unsigned int id = g->n;
+	graphReserve(g, id + 1);
+	g->name[id] = name;
+	g->type[id] = type;
+	g->compl[id] = compl;
+	g->fanin0[id] = fanin0;
+	g->fanin1[id] = fanin1;
+	g->arrival[id] = 0.0 ;
+	g->required[id] = DBL_MAX;
+	g->slack[id] = 0.0 ;
+	g->inv_slack0[id] = 0.0 ;
+	g->inv_slack1[id] = 0.0 ;
+	g->inv0_id[id] = -1;
+	g->inv1_id[id] = -1;
+	g->nand_id[id] = -1;
+
+	if(type == PI){
+		// only PIs don't have to compare required_time with min()
+		g->required[id] = 0.0 ;
 	}
+	g->n++;
+	return id;
 }
 
-int getIndex(Abc_Obj_t *obj){
-	// for getting the node index in nodes
-	for (int idx = 0; idx < node_count; idx++){
-		if (nodes[idx].obj->Id == obj->Id)
-			return idx;
+#ifdef ACE_USE_ABC
+void PrintEachObj(Abc_Ntk_t *ntk){
+	Abc_Obj_t *node, *fi;
+	int i, j;
+	
+	printf("<< Print Each Obj- >>\n");
+	printf(" ID       Name  Type  Level\n");
+	printf("--------------------\n");
+	Abc_NtkForEachObj(ntk, node, i){
+		printf("%3d %10s %2d %2d\n", node->Id, Abc_ObjName(node), node->Type, node->Level);
+
+		Abc_ObjForEachFanin(node, fi, j){
+			printf("  %10s %d\n", Abc_ObjName(fi), Abc_ObjFaninC(node, j));
+		}
 	}
-	return -1;
+	printf("<< ----- End ----- >>\n");
 }
 
-void initNode(Abc_Obj_t* obj){
-	nodes[node_count].obj = obj;
-	nodes[node_count].delay = 0.0 ;
-	nodes[node_count].arrival0 = 0.0 ;
-	nodes[node_count].arrival1 = 0.0 ;
-	nodes[node_count].required_time = DBL_MAX;
-	nodes[node_count].slack = 0.0 ;
-	nodes[node_count].inv_slack0 = 0.0 ;
-	nodes[node_count].inv_slack1 = 0.0 ;
-	nodes[node_count].inv0_id = -1;
-	nodes[node_count].inv1_id = -1;
-	nodes[node_count].nand_id = -1;
-	nodes[node_count].inv0_gateID = 0; // renaming purpose
-	nodes[node_count].inv1_gateID = 0; // renaming purpose
-	nodes[node_count].nand_gateID = 0; // renaming purpose
-
-	if(obj->Type == ABC_OBJ_PI){
-		// only PIs don't have to compare required_time with min()
-		nodes[node_count].required_time = 0.0 ;
-
-	}else{
-		// getting the node index of inputs
+void initNode(timing_graph *g, int *id2index, Abc_Obj_t* obj, int type){
+	int fanins[2] = {-1, -1};
+	if(obj->Type != ABC_OBJ_PI){
+		// getting the node index of inputs, fanins are always initialized before their fanouts
 		Abc_Obj_t* fanin;
 		int i;
 		Abc_ObjForEachFanin(obj, fanin, i) {
-			int index = getIndex(fanin);
-			nodes[node_count].inputs[i] = index;
+			fanins[i] = id2index[fanin->Id];
 		}
 	}
+	int compl = obj->fCompl0 | (obj->fCompl1 << 1);
+	// an output driven by Const1 becomes a constant output: fanin0 -1, value in bit0
+	if(type == PO && Abc_ObjFanin0(obj)->Type == ABC_OBJ_CONST1) compl = !obj->fCompl0;
+	char *name = type == GATE ? NULL : strdup(Abc_ObjName(obj));
+	id2index[obj->Id] = graphAddNode(g, type, fanins[0], fanins[1], compl, name);
 }
 
-void createnodes(Abc_Ntk_t *ntk){
+void createnodes(timing_graph *g, Abc_Ntk_t *ntk){
 	Abc_Obj_t *obj;
 	int i;
+	// sized once at load time, graphAddNode() still grows on demand
+	graphReserve(g, Abc_NtkObjNumMax(ntk));
+	// dense ABC Id -> node index map, -1: object not in graph
+	int *id2index = malloc(Abc_NtkObjNumMax(ntk) * sizeof(int));
+	if(!id2index){
+		printf("Error: out of memory for %d objects\n", Abc_NtkObjNumMax(ntk));
+		exit(1);
+	}
+	memset(id2index, -1, Abc_NtkObjNumMax(ntk) * sizeof(int));
 	// Initialized in topological order
 	Abc_NtkForEachPi(ntk, obj, i){
-		nodes[node_count].type = PI;
-		initNode(obj);
-		++node_count;
+		initNode(g, id2index, obj, PI);
 	}
 	Abc_NtkForEachNode(ntk, obj, i){
-		nodes[node_count].type = GATE;
-		initNode(obj);
-		++node_count;
+		initNode(g, id2index, obj, GATE);
 	}
 	Abc_NtkForEachPo(ntk, obj, i){
-		nodes[node_count].type = PO;
-		initNode(obj);
-		++node_count;
+		initNode(g, id2index, obj, PO);
 	}
+	free(id2index);
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
 }
+#endif
 
-void initialDelay(){
-	// calculate delay for each gate
-	for(unsigned int node_id=0; node_id < node_count; node_id++){
-		if(nodes[node_id].type == PI){
+void initialDelay(timing_graph *g){
+	// pick the fastest cell for every gate
+	for(unsigned int node_id=0; node_id < g->n; node_id++){
+		if(g->type[node_id] == PI || g->fanin0[node_id] < 0){
+			// constant outputs are tied off, no cell
 			continue;
 		}else{
-			// PO + INV
-			if(nodes[node_id].type == PO){
-				// PO has only one fanin
-				nodes[node_id].arrival0 = nodes[nodes[node_id].inputs[0]].delay;
-				if(nodes[node_id].obj->fCompl0 == 1){
-					// get the fastest inverter in library
-					double min_delay = DBL_MAX;
-					int selected_inv_id = -1;
-					for(int inv=0; inv<inv_count; ++inv){
-						double delay = inverters[inv].timing[0] + inverters[inv].timing[1];
-						if(min_delay > delay){
-							selected_inv_id = inv;
-							min_delay = delay;
-						}
-					}
-					nodes[node_id].delay += min_delay;
-					nodes[node_id].inv0_id = selected_inv_id;
-					if(selected_inv_id != -1){
-						_original_area += inverters[selected_inv_id].area; // update original_area
-						_inv++;
-					}
-				}	
-				nodes[node_id].delay += nodes[nodes[node_id].inputs[0]].delay;
-				_initial_delay = max(nodes[node_id].delay, _initial_delay); // update initial_delay with POs
-			}else{
-				// NAND + INV
-				nodes[node_id].arrival0 = nodes[nodes[node_id].inputs[0]].delay;
-				nodes[node_id].arrival1 = nodes[nodes[node_id].inputs[1]].delay;
-				// NAND has two fanins
-				// double fanin0_delay=max(nodes[node_id].arrival0, nodes[node_id].arrival1),
-				// 	   fanin1_delay=max(nodes[node_id].arrival0, nodes[node_id].arrival1);
-				double fanin0_delay = nodes[node_id].arrival0,
-					   fanin1_delay = nodes[node_id].arrival1;
-				// fanin0
-				if(nodes[node_id].obj->fCompl0 == 1){
-					// get the fastest inverter in library
-					double min_delay = DBL_MAX;
-					int selected_inv_id = -1;
-					for(int inv=0; inv<inv_count; inv++){
-						double delay = inverters[inv].timing[0] + inverters[inv].timing[1];
-						if(min_delay > delay){
-							selected_inv_id = inv;
-							min_delay = delay;
-						}
-					}
-					fanin0_delay += min_delay;
-					nodes[node_id].inv0_id = selected_inv_id; // inverter library id
-					if(selected_inv_id != -1){
-						_original_area += inverters[selected_inv_id].area; // update original_area
-						_inv++;		
-					}
-				}
-				// fanin1
-				if(nodes[node_id].obj->fCompl1 == 1){
-					// get the fastest inverter in library
-					double min_delay = DBL_MAX;
-					int selected_inv_id = -1;
-					for(int inv=0; inv<inv_count; inv++){
-						double delay = inverters[inv].timing[0] + inverters[inv].timing[1];
-						if(min_delay > delay){
-							selected_inv_id = inv;
-							min_delay = delay;
-						}
-					}
-					fanin1_delay += min_delay;
-					nodes[node_id].inv1_id = selected_inv_id; // inverter library id
-					if(selected_inv_id != -1){
-						_original_area += inverters[selected_inv_id].area; // update original_area
-						_inv++;
-					}
-				}
-				nodes[node_id].delay += max(fanin0_delay, fanin1_delay);
-				
-				// nand
-				// get the fastest nand in library
-				double min_delay = DBL_MAX;
-				int selected_nand_id = -1;
-				for(int nand_id=0; nand_id<nand_count; nand_id++){
-					double delay = nands[nand_id].timing[0] + nands[nand_id].timing[1]*Abc_ObjFanoutNum(nodes[node_id].obj);
-					if(min_delay > delay){
-						selected_nand_id = nand_id;
-						min_delay = delay;
-					}
-				}
-				nodes[node_id].nand_id = selected_nand_id; // nand library id
-				nodes[node_id].delay += min_delay;
-				if(selected_nand_id != -1){
-					_original_area += nands[selected_nand_id].area; // update original_area
-					nand++;	
+			// PO + INV, NAND + INV
+			// fanin0
+			if(COMPL0(g, node_id) == 1){
+				// get the fastest inverter in library
+				int selected_inv_id = libt.inv_fastest[INV_LOAD(g, node_id)];
+				g->inv0_id[node_id] = selected_inv_id; // inverter library id
+				if(selected_inv_id != -1){
+					g->original_area += inverters[selected_inv_id].area; // update original_area
+					g->inv_cells++;		
 				}
 			}
-		}
-	}
+			// PO and shared inverters have only one fanin
+			if(g->type[node_id] != GATE) continue;
 
-	// calculate required_time for each gate
-	for(int node_id = node_count-1; node_id >=0; node_id--){
-		if(nodes[node_id].type == PI){
-			continue;
-		}else{
-			if(nodes[node_id].type == PO){
-				nodes[node_id].required_time = min(_initial_delay, nodes[node_id].required_time); // critical path time
-				if(nodes[nodes[node_id].inputs[0]].type!=PI){ // update only PO and gates required_time
-					if(nodes[node_id].obj->fCompl0 == 1){
-						nodes[nodes[node_id].inputs[0]].required_time = min(nodes[node_id].required_time - (inverters[nodes[node_id].inv0_id].timing[0] + inverters[nodes[node_id].inv0_id].timing[1]), nodes[nodes[node_id].inputs[0]].required_time);
-					}else{
-						nodes[nodes[node_id].inputs[0]].required_time = min(nodes[node_id].required_time, nodes[nodes[node_id].inputs[0]].required_time);
-					}
+			// fanin1
+			if(COMPL1(g, node_id) == 1){
+				// get the fastest inverter in library
+				int selected_inv_id = libt.inv_fastest[1];
+				g->inv1_id[node_id] = selected_inv_id; // inverter library id
+				if(selected_inv_id != -1){
+					g->original_area += inverters[selected_inv_id].area; // update original_area
+					g->inv_cells++;
 				}
 			}
-			else{
-				double nand_delay = nands[nodes[node_id].nand_id].timing[0] + nands[nodes[node_id].nand_id].timing[1]*Abc_ObjFanoutNum(nodes[node_id].obj);
-				if(nodes[nodes[node_id].inputs[0]].type!=PI){ // update only PO and gates required_time
-					if(nodes[node_id].obj->fCompl0 == 1){
-						nodes[nodes[node_id].inputs[0]].required_time = min(nodes[node_id].required_time - (nand_delay + inverters[nodes[node_id].inv0_id].timing[0] + inverters[nodes[node_id].inv0_id].timing[1]), nodes[nodes[node_id].inputs[0]].required_time);
-					}else{
-						nodes[nodes[node_id].inputs[0]].required_time = min(nodes[node_id].required_time - nand_delay, nodes[nodes[node_id].inputs[0]].required_time);
-					}
-				}
-				if(nodes[nodes[node_id].inputs[1]].type!=PI){ // update only PO and gates required_time
-					if(nodes[node_id].obj->fCompl1 == 1){
-						nodes[nodes[node_id].inputs[1]].required_time = min(nodes[node_id].required_time - (nand_delay + inverters[nodes[node_id].inv1_id].timing[0] + inverters[nodes[node_id].inv1_id].timing[1]), nodes[nodes[node_id].inputs[1]].required_time);
-					}else{
-						nodes[nodes[node_id].inputs[1]].required_time = min(nodes[node_id].required_time - nand_delay, nodes[nodes[node_id].inputs[1]].required_time);
-					}
-				}
+			
+			// nand
+			// get the fastest nand in library
+			int selected_nand_id = libt.nand_fastest[FANOUT_NUM(g, node_id)];
+			g->nand_id[node_id] = selected_nand_id; // nand library id
+			if(selected_nand_id != -1){
+				g->original_area += nands[selected_nand_id].area; // update original_area
+				g->nand_cells++;
 			}
 		}
 	}
+
+	PROF_COUNT(PROF_NODES, g->n);
+	PROF_COUNT(PROF_INV_ADDED, g->inv_cells);
+
+	// calculate arrival time for each gate
+	staForward(g);
+	for(unsigned int node_id=0; node_id < g->n; node_id++){
+		if(g->type[node_id] == PO)
+			g->initial_delay = max(g->arrival[node_id], g->initial_delay); // update initial_delay with POs
+	}
+
+	// calculate required_time for each gate, critical path time at POs
+	staBackward(g, g->initial_delay);
 }
 
-void optimization(){
+void optimization(timing_graph *g){
 	// greedy algo: find the smallest gate in library to replace the orignal gate
 	// step1: update NAND
 	// step2: update INV1 and INV2
-	for (int i = 0; i < node_count; i++){
-		if(nodes[i].type == PI){
-			nodes[i].delay = 0; // ensure PIs delay isn't modified
+	PROF_COUNT(PROF_NODES, g->n);
+	for (int i = 0; i < g->n; i++){
+		if(g->type[i] == PI){
+			g->arrival[i] = PI_ARRIVAL(g, i); // ensure PIs delay isn't modified
+		}else if(g->type[i] == INVERTER){
+			// shared inverter, sized against its fanout load
+			int load = FANOUT_NUM(g, i);
+			double arrival0 = g->arrival[g->fanin0[i]];
+			g->inv_slack0[i] = g->required[i] - arrival0;
+			if(g->inv_slack0[i] > 0){
+				int j = smallestInv(load, g->inv_slack0[i]);
+				if(j >= 0){
+					PROF_COUNT(PROF_SWAPS, j != g->inv0_id[i]);
+					g->inv0_id[i] = j;
+				}
+			}
+			g->inv_slack0[i] -= INV_DELAY(load, g->inv0_id[i]);
+			g->arrival[i] = arrival0 + INV_DELAY(load, g->inv0_id[i]);
+			g->optimized_area += inverters[g->inv0_id[i]].area;
 		}else{
-			if(nodes[i].type == PO){
-				nodes[i].arrival0 = nodes[nodes[i].inputs[0]].delay; // get arrival time
-				if(nodes[i].obj->fCompl0 == 1){
-					nodes[i].inv_slack0 = nodes[i].required_time - nodes[i].arrival0; // only INV has slack
-					if(nodes[i].inv_slack0 > 0){
-						for (int j = 0; j < inv_count; j++){ // find the smallest INV to replace the original INV
-							double new_time = inverters[j].timing[0] + inverters[j].timing[1];
-							if (new_time <= nodes[i].inv_slack0){
-								nodes[i].inv_slack0 -= new_time;
-								nodes[i].inv0_id = j;
-								nodes[i].delay = nodes[i].arrival0 + new_time; // update delay for node
-								_optimized_area += inverters[nodes[i].inv0_id].area;
-								break;
-							}
+			if(g->type[i] == PO){
+				if(g->fanin0[i] < 0) continue; // constant output
+				double arrival0 = g->arrival[g->fanin0[i]]; // get arrival time
+				if(COMPL0(g, i) == 1){
+					g->inv_slack0[i] = g->required[i] - arrival0; // only INV has slack
+					if(g->inv_slack0[i] > 0){
+						int j = smallestInv(1, g->inv_slack0[i]); // find the smallest INV to replace the original INV
+						if (j >= 0){
+							double new_time = INV_DELAY(1, j);
+							g->inv_slack0[i] -= new_time;
+							PROF_COUNT(PROF_SWAPS, j != g->inv0_id[i]);
+							g->inv0_id[i] = j;
+							g->arrival[i] = arrival0 + new_time; // update delay for node
+							g->optimized_area += inverters[g->inv0_id[i]].area;
 						}
 					}
 				}else{
-					nodes[i].delay = nodes[i].arrival0; // update delay for node
+					g->arrival[i] = arrival0; // update delay for node
 				}
 			}
 			else{
+				int fanout_num = FANOUT_NUM(g, i);
 				// get fanin0 arrival time
-				nodes[i].arrival0 = nodes[nodes[i].inputs[0]].delay;
-				double inv_time1 = 0.0, nand_arrival1 = nodes[i].arrival0;
-				if(nodes[i].obj->fCompl0 == 1){
-					inv_time1 = inverters[nodes[i].inv0_id].timing[0] + inverters[nodes[i].inv0_id].timing[1];
+				double arrival0 = g->arrival[g->fanin0[i]];
+				double inv_time1 = 0.0, nand_arrival1 = arrival0;
+				if(COMPL0(g, i) == 1){
+					inv_time1 = INV_DELAY(1, g->inv0_id[i]);
 					nand_arrival1 += inv_time1;
 				}
 
 				// get fanin1 arrival time
-				nodes[i].arrival1 = nodes[nodes[i].inputs[1]].delay;  
-				double inv_time2 = 0.0, nand_arrival2 = nodes[i].arrival1;
-				if(nodes[i].obj->fCompl1 == 1){
-					inv_time2 = inverters[nodes[i].inv1_id].timing[0] + inverters[nodes[i].inv1_id].timing[1];
+				double arrival1 = g->arrival[g->fanin1[i]];
+				double inv_time2 = 0.0, nand_arrival2 = arrival1;
+				if(COMPL1(g, i) == 1){
+					inv_time2 = INV_DELAY(1, g->inv1_id[i]);
 					nand_arrival2 += inv_time2;
 				}
 
 				// step1: find better NAND
-				double nand_slack = nodes[i].required_time - max(nand_arrival1, nand_arrival2);
-				double inv1_slack = nodes[i].required_time - nodes[i].arrival0;
-				double inv2_slack = nodes[i].required_time - nodes[i].arrival1;
-				double nand_time = nands[nodes[i].nand_id].timing[0] + (nands[nodes[i].nand_id].timing[1]  * Abc_ObjFanoutNum(nodes[i].obj));
+				double nand_slack = g->required[i] - max(nand_arrival1, nand_arrival2);
+				double inv1_slack = g->required[i] - arrival0;
+				double inv2_slack = g->required[i] - arrival1;
+				double nand_time = NAND_DELAY(fanout_num, g->nand_id[i]);
 
 				if (nand_slack > 0){
-					for (int j = 0; j< nand_count; j++){ // find the smallest NAND to replace the original NAND
-						double new_time = nands[j].timing[0] + (nands[j].timing[1]  * Abc_ObjFanoutNum(nodes[i].obj));
-						if (new_time <= nand_slack){
-							nand_time = new_time;
-							nodes[i].nand_id = j;
-							break;
-						}
+					int j = smallestNand(fanout_num, nand_slack); // find the smallest NAND to replace the original NAND
+					if (j >= 0){
+						nand_time = NAND_DELAY(fanout_num, j);
+						PROF_COUNT(PROF_SWAPS, j != g->nand_id[i]);
+						g->nand_id[i] = j;
 					}
 				}
 				nand_slack -= nand_time;
 				inv1_slack -= nand_time;
 				inv2_slack -= nand_time;
-				_optimized_area += nands[nodes[i].nand_id].area; // update optimized_area
-				nodes[i].slack = nand_slack;
+				g->optimized_area += nands[g->nand_id[i]].area; // update optimized_area
+				g->slack[i] = nand_slack;
 
 				// step2: find better INV0 (independent to INV1)
-				if(nodes[i].obj->fCompl0 == 1){
+				if(COMPL0(g, i) == 1){
 					if (inv1_slack > 0){
-						for (int j = 0; j < inv_count; j++){ // find the smallest INV to replace the original INV
-							double new_time = inverters[j].timing[0] + inverters[j].timing[1];
-							if (new_time <= inv1_slack){
-								inv1_slack -= new_time;
-								inv_time1 = new_time;
-								nand_arrival1 = nodes[i].arrival0 + new_time;
-								nodes[i].inv0_id = j;
-								break;
-							}
+						int j = smallestInv(1, inv1_slack); // find the smallest INV to replace the original INV
+						if (j >= 0){
+							double new_time = INV_DELAY(1, j);
+							inv1_slack -= new_time;
+							inv_time1 = new_time;
+							nand_arrival1 = arrival0 + new_time;
+							PROF_COUNT(PROF_SWAPS, j != g->inv0_id[i]);
+							g->inv0_id[i] = j;
 						}
 					}
-					_optimized_area += inverters[nodes[i].inv0_id].area; // update optimized_area
-					nodes[i].inv_slack0 = inv1_slack;
+					g->optimized_area += inverters[g->inv0_id[i]].area; // update optimized_area
+					g->inv_slack0[i] = inv1_slack;
 				}
 
 				// step2: find better INV1 (independent to INV0)
-				if(nodes[i].obj->fCompl1 == 1){
+				if(COMPL1(g, i) == 1){
 					if (inv2_slack > 0){
-						for (int j = 0; j < inv_count; j++){ // find the smallest INV to replace the original INV
-							double new_time = inverters[j].timing[0] + inverters[j].timing[1];
-							if (new_time <= inv2_slack){
-								inv2_slack -= new_time;
-								inv_time2 = new_time;
-								nand_arrival2 = nodes[i].arrival1 + new_time;
-								nodes[i].inv1_id = j;
-								break;
-							}
+						int j = smallestInv(1, inv2_slack); // find the smallest INV to replace the original INV
+						if (j >= 0){
+							double new_time = INV_DELAY(1, j);
+							inv2_slack -= new_time;
+							inv_time2 = new_time;
+							nand_arrival2 = arrival1 + new_time;
+							PROF_COUNT(PROF_SWAPS, j != g->inv1_id[i]);
+							g->inv1_id[i] = j;
 						}
 					}
-					_optimized_area += inverters[nodes[i].inv1_id].area; // update optimized_area
-					nodes[i].inv_slack1 = inv2_slack;
+					g->optimized_area += inverters[g->inv1_id[i]].area; // update optimized_area
+					g->inv_slack1[i] = inv2_slack;
 				}				
-				nodes[i].delay = max(nand_arrival1, nand_arrival2) + nand_time; // update node delay
-				if(nodes[i].delay > _initial_delay){
+				g->arrival[i] = max(nand_arrival1, nand_arrival2) + nand_time; // update node delay
+				if(g->arrival[i] > g->required[i] + 1e-9 * g->initial_delay){
 					printf("error");
 				}
 			}
@@ -503,169 +455,677 @@ void optimization(){
 	}
 }
 
-int int_length(int num) {
-    if (num == 0) return 1;
-    int length = 0;
-    if (num < 0) {
-        length = 1;
-        num = -num;
-    }
-    return length + (int)log10(num) + 1;
+char *outputName(const char *input, const char *ext){
+	// input path with its extension replaced by ext, caller frees
+	const char *base = strrchr(input, '/');
+	const char *dot = strrchr(base ? base : input, '.');
+	size_t len = dot ? (size_t)(dot - input) : strlen(input);
+	char *name = malloc(len + strlen(ext) + 1);
+	memcpy(name, input, len);
+	strcpy(name + len, ext);
+	return name;
+}
+
+//***********************************************************
+// driver
+enum {SIZER_GREEDY, SIZER_LR, SIZER_DP}; // --sizer
+
+typedef struct run_options{
+	int sizer;	// SIZER_*
+	double sizer_time;	// time budget of the lr sizer
+	int sta_bench;	// full timing passes to time, 0: none
+	int threads;	// threads of the full timing passes (reported by --sta-bench), with partitions its workers
+	int partitions;	// --partitions: regions sized concurrently by the greedy pass, 0: one serial pass
+	int use_abc;	// read through ABC's Io_ReadBlifAsAig()
+	int verbose;	// per-phase report on stdout
+	int restructure;	// rebalance critical AND trees before mapping (--restructure)
+	double restructure_time;	// its time budget in seconds
+	int polarity;	// rebuild XORs to save inverters (--polarity)
+	int share_inv;	// one inverter per inverted net (--share-inv)
+	int buffer_fanout;	// with share_inv: split nets above this many sinks, 0: never
+	int binary;	// also write the .mbin binary netlist
+	int slack_on;	// slack annotation in the outputs
+	const char *cache;	// --cache DIR: stored results and cone sizings, NULL: none
+	int verify;	// simulate the written .mbench against the input circuit
+	int report;	// critical paths in the .timing report, 0: no report
+	int sweep;	// --sweep: size for every target lo, lo+step, .. hi instead, writing the area-delay curve
+	double sweep_lo, sweep_hi, sweep_step;	// times, or factors of the constraint delay with sweep_relative
+	int sweep_relative;
+	const timing_constraints *constraints;	// --constraints/--target, NULL: the fastest delay at the nominal corner
+} run_options;
+
+typedef struct run_result{
+	int ok;
+	unsigned int nodes;
+	double initial_delay;
+	double original_area;
+	double optimized_area;
+	double worst_slack;
+	double runtime;	// seconds from read to write
+} run_result;
+
+static unsigned long long runContext(const run_options *opt){
+	// --cache: what a run depends on besides the circuit, the library, the constraints and the options
+	unsigned long long h = hashMix(libHash(), constraintsHash(opt->constraints));
+	h = hashDouble(hashMix(h, opt->sizer), opt->sizer_time);
+	h = hashDouble(hashMix(h, opt->restructure), opt->restructure_time);
+	h = hashMix(hashMix(h, opt->polarity), opt->share_inv);
+	h = hashMix(hashMix(h, opt->buffer_fanout), opt->slack_on);
+	if(opt->partitions > 1) h = hashMix(h, opt->partitions);
+	return hashMix(h, opt->use_abc);
+}
+
+#define SWEEP_MAX 10000 // --sweep targets
+
+static int sweepPoints(const run_options *opt){
+	return (int)floor((opt->sweep_hi - opt->sweep_lo) / opt->sweep_step + 1e-9) + 1;
 }
 
-void Write(const char *pFileName, Abc_Ntk_t *ntk){
-	FILE *pFile;
-	pFile = fopen(pFileName, "w");
-	if (pFile == NULL)
-	{
-		fprintf(stdout, "Io_WriteBench(): Cannot open the output file.\n");
-		return;
+static int sweepTargets(timing_graph *g, const run_options *opt, const char *input, double base, double fastest){
+	// --sweep, after initialDelay(): targets from the tightest up, each sized starting from the cells
+	// of the one before, which still meet the looser target; writes benchmark_name.sweep.csv,
+	// returns 0 when it can't or no target could be sized
+	char *file_name = outputName(input, ".sweep.csv");
+	FILE *file = fopen(file_name, "w");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		free(file_name);
+		return 0;
+	}
+	fprintf(file, "target,delay,area,worst_slack,seconds\n");
+	double t0 = wallTime();
+	int points = sweepPoints(opt), sized = 0;
+	for(int k = 0; k < points; k++){
+		double target = (opt->sweep_lo + k * opt->sweep_step) * (opt->sweep_relative ? base : 1.0);
+		// the fastest cells don't get there, and the cells sized so far assume a later target
+		if(target < fastest - 1e-9 * fastest) continue;
+		double t_point = wallTime();
+		g->initial_delay = target;
+		if(opt->sizer == SIZER_LR) sizeLR(g, target, opt->sizer_time);
+		else if(opt->sizer == SIZER_DP) sizeDP(g, target);
+		else staFull(g, target);
+		g->optimized_area = 0.0;
+		optimization(g);
+		double delay = 0.0, worst = DBL_MAX;
+		for(unsigned int i = 0; i < g->n; i++){
+			if(g->type[i] != PO || g->fanin0[i] < 0) continue;
+			delay = max(delay, g->arrival[i]);
+			worst = min(worst, PO_REQUIRED(g, i, target) - g->arrival[i]);
+		}
+		fprintf(file, "%.3f,%.3f,%.3f,%.3f,%.4f\n", target, delay, g->optimized_area,
+			FIX_NEG_ZERO(worst == DBL_MAX ? target : worst), wallTime() - t_point);
+		sized++;
 	}
+	int ok = fclose(file) == 0;
+	if(!ok) printf("Error: cannot write %s\n", file_name);
+	if(sized == 0){
+		// a curve without points is no result
+		printf("Error: every sweep target is below the fastest delay %.3f\n", fastest);
+		unlink(file_name);
+		ok = 0;
+	}else if(opt->verbose){
+		if(sized < points) printf("Warning: %d sweep targets below the fastest delay %.3f skipped\n", points - sized, fastest);
+		printf("sweep: %d targets in %.4f s, written to %s\n", sized, wallTime() - t0, file_name);
+	}
+	free(file_name);
+	return ok;
+}
 
-	fprintf(pFile, "Initial delay : %.3f\n", _initial_delay);
-	fprintf(pFile, "Original area : %.3f\n", _original_area);
-	fprintf(pFile, "Optimized area : %.3f\n", _optimized_area);
+static int runCircuit(const char *input, const run_options *opt, run_result *res){
+	// read, size and write one circuit, all circuit state lives in a local graph
+	timing_graph graph;
+	memset(&graph, 0, sizeof(graph));
+	memset(res, 0, sizeof(*res));
+	if(opt->verbose) printf("Process %s\n", input);
+	profCircuit(input);
+	profBegin("circuit");
 
-	Abc_Obj_t *obj;
-	int i;
-	Abc_NtkForEachPi(ntk, obj, i)
-		fprintf(pFile, "INPUT(%s)\n", Abc_ObjName(obj));
-	Abc_NtkForEachPo(ntk, obj, i)
-		fprintf(pFile, "OUTPUT(%s)\n", Abc_ObjName(obj));
-
-	int fixed_length = 45;
-	for (int i = 0, g = 1; i < node_count; i++){
-		if(nodes[i].type == PI){
-			continue;
-		}else{
-			if(nodes[i].type == PO){
-				if (nodes[nodes[i].inputs[0]].type != PI){
-					if(nodes[i].obj->fCompl0){
-						int padding = fixed_length - 7 - (int_length(g) + strlen(inverters[nodes[i].inv0_id].name) + int_length(nodes[nodes[i].inputs[0]].nand_gateID));
-						fprintf(pFile, "X%d = %s(X%d)%*s slack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, nodes[nodes[i].inputs[0]].nand_gateID, padding, "", FIX_NEG_ZERO(nodes[i].inv_slack0));
-						// fprintf(pFile, "X%d = %s(X%d)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, nodes[nodes[i].inputs[0]].nand_gateID, nodes[i].inv_slack0);
-					}
-				}
-				// fanin0 is PI
-				else{
-					if(nodes[i].obj->fCompl0){
-						int padding = fixed_length - 6 - (int_length(g) + strlen(inverters[nodes[i].inv0_id].name) + strlen(Abc_ObjName(nodes[nodes[i].inputs[0]].obj)));
-						fprintf(pFile, "X%d = %s(%s)%*s slack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, Abc_ObjName(nodes[nodes[i].inputs[0]].obj), padding, "", FIX_NEG_ZERO(nodes[i].inv_slack0));						
-						// fprintf(pFile, "X%d = %s(%s)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, Abc_ObjName(nodes[nodes[i].inputs[0]].obj), nodes[i].inv_slack0);
-					}
-				}
-			}else{
-				char input1[10];
-				char input2[10];
-				// fanin0
-				if (nodes[nodes[i].inputs[0]].type != PI){
-					if(nodes[i].obj->fCompl0){
-						nodes[i].inv0_gateID = g;
-
-						int padding = fixed_length - 7 - (int_length(g) + strlen(inverters[nodes[i].inv0_id].name) + int_length(nodes[nodes[i].inputs[0]].nand_gateID));
-						fprintf(pFile, "X%d = %s(X%d)%*s slack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, nodes[nodes[i].inputs[0]].nand_gateID, padding, "", FIX_NEG_ZERO(nodes[i].inv_slack0));
-						// fprintf(pFile, "X%d = %s(X%d)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, nodes[nodes[i].inputs[0]].nand_gateID, nodes[i].inv_slack0);
-						sprintf(input1, "X%d", nodes[i].inv0_gateID);
-					}else{
-						sprintf(input1, "X%d", nodes[nodes[i].inputs[0]].nand_gateID);
-					}
-				}
-				// fanin0 is PI
-				else{
-					if(nodes[i].obj->fCompl0){
-						nodes[i].inv0_gateID = g;
-
-						int padding = fixed_length - 6 - (int_length(g) + strlen(inverters[nodes[i].inv0_id].name) + strlen(Abc_ObjName(nodes[nodes[i].inputs[0]].obj)));
-						fprintf(pFile, "X%d = %s(%s)%*s slack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, Abc_ObjName(nodes[nodes[i].inputs[0]].obj), padding, "", FIX_NEG_ZERO(nodes[i].inv_slack0));
-						// fprintf(pFile, "X%d = %s(%s)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv0_id].name, Abc_ObjName(nodes[nodes[i].inputs[0]].obj), nodes[i].inv_slack0);
-						sprintf(input1, "X%d", nodes[i].inv0_gateID);
-					}else{
-						strcpy(input1, Abc_ObjName(nodes[nodes[i].inputs[0]].obj));
-					}
-				}
+  	// step1: << Read netlist >>
+	double t_read = wallTime();
+	size_t bytes = 0;
+	profBegin("read");
+#ifdef ACE_USE_ABC
+	if(opt->use_abc){
+		char circuit[1024];
+		Abc_Ntk_t *ntk;
+		Abc_Start();
+		snprintf(circuit, sizeof(circuit), "%s", input);
+		profBegin("Io_ReadBlifAsAig");
+		ntk = Io_ReadBlifAsAig(circuit, 1);
+		profEnd();
+		if (!ntk){
+			profEnd();
+			profEnd();
+			return 0; 
+		}
+		profBegin("createnodes");
+		createnodes(&graph, ntk);
+		profEnd();
+		// PrintEachObj(ntk);
+		Abc_NtkDelete(ntk);
+		Abc_Stop();
+	}else
+#endif
+	if(!readNetwork(&graph, input, &bytes)){
+		graphFree(&graph);
+		profEnd();
+		profEnd();
+		return 0;
+	}
+	profEnd();
+	if(opt->verbose && bytes > 0){
+		double t = wallTime() - t_read;
+		printf("read: %.2f MB in %.4f s (%.1f MB/s)\n", bytes / 1e6, t, bytes / 1e6 / t);
+	}
+	// a stored run of the same circuit, library, constraints and options is the result
+	unsigned long long context = opt->cache ? runContext(opt) : 0;
+	unsigned long long key = opt->cache ? hashMix(graphHash(&graph), context) : 0;
+	int cached = opt->cache && !opt->sweep && opt->report == 0 && opt->sta_bench == 0;
+	cache_result hit;
+	if(cached && cacheLoad(opt->cache, key, input, opt->binary, opt->verify, &hit)){
+		if(opt->verbose){
+			printf("cache: hit %016llx\n", key);
+			printf("initial_delay: %f\noriginal_area: %f\noptimized_area: %f\nworst_slack: %f\n", hit.initial_delay,
+				hit.original_area, hit.optimized_area, hit.worst_slack);
+		}
+		*res = (run_result){1, hit.nodes, hit.initial_delay, hit.original_area, hit.optimized_area, hit.worst_slack,
+			wallTime() - t_read};
+		graphFree(&graph);
+		profEnd();
+		return 1;
+	}
+	if(cached && opt->verbose) printf("cache: miss %016llx\n", key);
 
-				// fanin1
-				if (nodes[nodes[i].inputs[1]].type != PI){
-					if(nodes[i].obj->fCompl1){
-						nodes[i].inv1_gateID = g;
-
-						int padding = fixed_length - 7 - (int_length(g) + strlen(inverters[nodes[i].inv1_id].name) + int_length(nodes[nodes[i].inputs[1]].nand_gateID));
-						fprintf(pFile, "X%d = %s(X%d)%*s slack : %.2f\n", g++, inverters[nodes[i].inv1_id].name, nodes[nodes[i].inputs[1]].nand_gateID, padding, "", FIX_NEG_ZERO(nodes[i].inv_slack1));
-						// fprintf(pFile, "X%d = %s(X%d)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv1_id].name, nodes[nodes[i].inputs[1]].nand_gateID, nodes[i].inv_slack1);
-						sprintf(input2, "X%d", nodes[i].inv1_gateID);
-					}else{
-						sprintf(input2, "X%d", nodes[nodes[i].inputs[1]].nand_gateID);
-					}
-				}
-				// fanin1 is PI
-				else{
-					if(nodes[i].obj->fCompl1){
-						nodes[i].inv1_gateID = g;
-
-						int padding = fixed_length - 6 - (int_length(g) + strlen(inverters[nodes[i].inv1_id].name) + strlen(Abc_ObjName(nodes[nodes[i].inputs[1]].obj)));
-						fprintf(pFile, "X%d = %s(%s)%*s slack : %.2f\n", g++, inverters[nodes[i].inv1_id].name, Abc_ObjName(nodes[nodes[i].inputs[1]].obj), padding, "", FIX_NEG_ZERO(nodes[i].inv_slack1));
-						// fprintf(pFile, "X%d = %s(%s)\t\t\tslack : %.2f\n", g++, inverters[nodes[i].inv1_id].name, Abc_ObjName(nodes[nodes[i].inputs[1]].obj), nodes[i].inv_slack1);
-						sprintf(input2, "X%d", nodes[i].inv1_gateID);
-					}else{
-						strcpy(input2, Abc_ObjName(nodes[nodes[i].inputs[1]].obj));
-					}
-				}
-				nodes[i].nand_gateID = g;
+	// step2: << map AND to NAND+INV >>
+	double t_create = wallTime();
+	profBegin("library");
+	// the rewrites below never raise the largest fanout above this
+	libUse(max(graphMaxFanout(&graph), 2));
+	profEnd();
+	double delay_bound = 0.0;	// with --restructure: the delay of the input structure
+	if(opt->restructure){
+		profBegin("restructure");
+		delay_bound = restructure(&graph, opt->restructure_time, opt->verbose);
+		profEnd();
+	}
+	profBegin("mapping");
+	mapping(&graph);
+	profEnd();
+	if(opt->polarity){
+		profBegin("polarity");
+		unsigned int before = graphInverters(&graph);
+		int rebuilt = assignPolarity(&graph);
+		profEnd();
+		if(opt->verbose){
+			unsigned int after = graphInverters(&graph);
+			printf("polarity: %d XORs rebuilt, inverters %u -> %u (%d removed)\n", rebuilt, before, after,
+				(int)before - (int)after);
+		}
+	}
+	if(opt->share_inv){
+		profBegin("shareInverters");
+		shareInverters(&graph, opt->buffer_fanout);
+		profEnd();
+	}
+
+	// step3: << calculate initial delay >>
+	double t_delay = wallTime();
+	profBegin("initialDelay");
+	const timing_constraints *constraints = opt->constraints;
+	if(constraints){
+		int missing = constrainPorts(&graph, constraints);
+		if(missing && opt->verbose) printf("constraints: %d ports not in %s\n", missing, input);
+	}
+	initialDelay(&graph);
+	double fastest = graph.initial_delay;
+	// the input structure's delay stays the constraint, the slack won goes to area
+	double target = max(fastest, delay_bound);
+	if(constraints) target = constraintTarget(constraints, target);
+	corner_timing corners = {0};
+	if(constraints) cornerStart(&corners, &graph, constraints, target, fastest);
+	if(target != graph.initial_delay || graph.port_time){
+		graph.initial_delay = target;
+		int relaxed = relaxRequired(&graph, target);
+		if(relaxed && opt->verbose) printf("Warning: %d outputs can't meet their required time, relaxed to the fastest delay\n", relaxed);
+		staBackward(&graph, target);
+	}
+	profEnd();
+	if(opt->verbose){
+		printf("NODE: %d INV: %d NAND: %d\n", graph.n, graph.inv_cells, graph.nand_cells);
+		printf("initial_delay: %f\noriginal_area: %f\n", graph.initial_delay, graph.original_area);
+	}
+	if(opt->sta_bench > 0){
+		// full forward+backward passes on the sized graph, same values as initialDelay()
+		double t0 = wallTime();
+		profBegin("sta-bench");
+		for(int i = 0; i < opt->sta_bench; i++) staFull(&graph, graph.initial_delay);
+		profEnd();
+		double t1 = wallTime();
+		printf("sta-bench: kernel %s threads %d levels %d  %.3f ms/pass  %.3f nodes/ns\n", staKernelName(), opt->threads,
+			graph.nlevels, (t1 - t0) * 1e3 / opt->sta_bench, 2.0 * graph.n * opt->sta_bench / (t1 - t0) * 1e-9);
+	}
+
+	// step4: << optimize area using slack>>
+	double t_opt = wallTime();
+	int seeded = 0;	// cones sized from the cache, the first round skips the sizer
+	if(opt->cache && !opt->sweep){
+		profBegin("cacheSeedCones");
+		seeded = cacheSeedCones(opt->cache, &graph, input, context, graph.initial_delay);
+		profEnd();
+		if(seeded && opt->verbose) printf("cache: %d cones of the previous run reused, sizer skipped\n", seeded);
+	}
+	int swept = 1;
+	if(opt->sweep){
+		profBegin("sweep");
+		swept = sweepTargets(&graph, opt, input, max(fastest, delay_bound), fastest);
+		profEnd();
+	}
+	for(int round = 1; !opt->sweep; round++){
+		double t_round = wallTime();
+		// cones from the cache leave only the new cones to size, the greedy pass does that
+		int sizer = seeded && round == 1 ? SIZER_GREEDY : opt->sizer;
+		if(sizer == SIZER_LR){
+			// relaxation first, the greedy pass then recovers the slack it left
+			profBegin("sizeLR");
+			int iter = sizeLR(&graph, graph.initial_delay, opt->sizer_time);
+			profEnd();
+			double t = wallTime() - t_round;
+			if(opt->verbose) printf("sizer lr: %d iterations in %.3f s (%.0f it/s)\n", iter, t, iter / t);
+		}else if(sizer == SIZER_DP && opt->partitions <= 1){
+			profBegin("sizeDP");
+			int passes = sizeDP(&graph, graph.initial_delay);
+			profEnd();
+			if(opt->verbose) printf("sizer dp: %d passes in %.3f s\n", passes, wallTime() - t_round);
+		}
+		profBegin("optimization");
+		if(opt->partitions > 1){
+			double t = wallTime();
+			// with --sizer dp the regions are solved exactly first
+			int rounds = sizePartitions(&graph, graph.initial_delay, opt->partitions, opt->threads, sizer == SIZER_DP,
+				opt->verbose);
+			if(opt->verbose) printf("partitions: %d rounds in %.3f s\n", rounds, wallTime() - t);
+		}else optimization(&graph);
+		profEnd();
+		if(corners.nc == 0) break;
+		profBegin("corners");
+		int tightened = cornerCheck(&corners, &graph, constraints, opt->verbose, round < CORNER_ROUNDS);
+		profEnd();
+		if(tightened == 0) break;
+		// size again from the fastest cells against the tightened required times
+		graph.original_area = graph.optimized_area = 0.0;
+		graph.inv_cells = graph.nand_cells = 0;
+		graph.initial_delay = 0.0;
+		initialDelay(&graph);
+		graph.initial_delay = target;
+		staBackward(&graph, target);
+	}
+	cornerFree(&corners);
+	if(opt->cache && !opt->sweep) cacheStoreCones(opt->cache, &graph, input, context);
+	libDone();
+	double worst_slack = DBL_MAX;
+	for(unsigned int i = 0; i < graph.n; i++){
+		if(graph.type[i] == PO) worst_slack = min(worst_slack, PO_REQUIRED(&graph, i, graph.initial_delay) - graph.arrival[i]);
+	}
+	if(worst_slack == DBL_MAX) worst_slack = graph.initial_delay;
+	if(opt->verbose){
+		printf("optimized_area: %f\n", graph.optimized_area);
+		printf("worst_slack: %f\n", worst_slack);
+	}
+
+	// step5: << output >>, a sweep only writes its curve
+	double t_write = wallTime();
+	profBegin("write");
+	char *file_name;
+	int verified = 1, written = 1, reported = 1;
+	if(!opt->sweep){
+		file_name = outputName(input, ".mbench");
+		written = Write(file_name, &graph, opt->slack_on);
+		if(written && opt->verify){
+			profBegin("verify");
+			verified = verifyNetlist(input, file_name, &graph, opt->verbose);
+			profEnd();
+		}
+		free(file_name);
+	}
+	if(opt->binary && !opt->sweep){
+		file_name = outputName(input, ".mbin");
+		written = WriteBinary(file_name, &graph, opt->slack_on) && written;
+		free(file_name);
+	}
+	if(opt->report > 0 && !opt->sweep){
+		profBegin("report");
+		file_name = outputName(input, ".timing");
+		reported = timingReport(file_name, &graph, graph.initial_delay, opt->report);
+		free(file_name);
+		profEnd();
+	}
+	profEnd();
+	// only netlists written in full (and verified, with --verify) become cache entries
+	if(cached && verified && written){
+		cacheStore(opt->cache, key, input, opt->binary, opt->verify, &(cache_result){graph.n, graph.initial_delay,
+			graph.original_area, graph.optimized_area, worst_slack});
+	}
+	double t_end = wallTime();
 
-				int padding_ = fixed_length - 8 - (int_length(g) + strlen(nands[nodes[i].nand_id].name) + strlen(input1) + strlen(input2));
-				fprintf(pFile, "X%d = %s(%s, %s)%*s slack : %.2f\n", g++, nands[nodes[i].nand_id].name, input1, input2, padding_, "", FIX_NEG_ZERO(nodes[i].slack));
-				// fprintf(pFile, "X%d = %s(%s, %s)\t\t\tslack : %.2f\n", g++, nands[nodes[i].nand_id].name, input1, input2, nodes[i].slack);
+	if(opt->verbose){
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		printf("runtime (s) read: %.4f mapping: %.4f initialDelay: %.4f optimization: %.4f write: %.4f\n",
+			t_create - t_read, t_delay - t_create, t_opt - t_delay, t_write - t_opt, t_end - t_write);
+		printf("peak_rss: %ld KB\n", usage.ru_maxrss);
+	}
+
+	res->ok = verified && written && swept && reported;
+	res->nodes = graph.n;
+	res->initial_delay = graph.initial_delay;
+	res->original_area = graph.original_area;
+	res->optimized_area = graph.optimized_area;
+	res->worst_slack = worst_slack;
+	res->runtime = t_end - t_read;
+	graphFree(&graph);
+	profEnd();
+	return res->ok;
+}
+
+//***********************************************************
+// batch mode
+static struct{
+	char **files;
+	int n;
+	int next;	// next file to hand out
+	pthread_mutex_t lock;
+	const run_options *opt;
+	run_result *results;
+} batch = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static int fileCompare(const void *a, const void *b){
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int batchFiles(const char *path){
+	// circuits of a directory (*.blif, *.aig by name) or of a list file (one path per line)
+	struct stat st;
+	if(stat(path, &st) != 0){
+		printf("Error: cannot open %s\n", path);
+		return 0;
+	}
+	int cap = 0;
+	if(S_ISDIR(st.st_mode)){
+		DIR *dir = opendir(path);
+		struct dirent *entry;
+		if(!dir){
+			printf("Error: cannot open %s\n", path);
+			return 0;
+		}
+		while((entry = readdir(dir))){
+			const char *ext = strrchr(entry->d_name, '.');
+			if(!ext || (strcmp(ext, ".blif") != 0 && strcmp(ext, ".aig") != 0)) continue;
+			if(batch.n == cap){
+				cap = cap * 2 + 16;
+				batch.files = realloc(batch.files, cap * sizeof(char *));
 			}
+			batch.files[batch.n] = malloc(strlen(path) + strlen(entry->d_name) + 2);
+			sprintf(batch.files[batch.n++], "%s/%s", path, entry->d_name);
+		}
+		closedir(dir);
+		qsort(batch.files, batch.n, sizeof(char *), fileCompare);
+	}else{
+		FILE *file = fopen(path, "r");
+		char line[4096];
+		if(!file){
+			printf("Error: cannot open %s\n", path);
+			return 0;
 		}
+		while(fgets(line, sizeof(line), file)){
+			char *name = strtok(line, " \t\r\n");
+			if(name == NULL || name[0] == '#') continue;
+			if(batch.n == cap){
+				cap = cap * 2 + 16;
+				batch.files = realloc(batch.files, cap * sizeof(char *));
+			}
+			batch.files[batch.n++] = strdup(name);
+		}
+		fclose(file);
+	}
+	if(batch.n == 0){
+		printf("Error: no circuits in %s\n", path);
+		return 0;
 	}
+	return 1;
+}
+
+static void *batchWorker(void *arg){
+	while(1){
+		pthread_mutex_lock(&batch.lock);
+		int k = batch.next++;
+		pthread_mutex_unlock(&batch.lock);
+		if(k >= batch.n) break;
+		runCircuit(batch.files[k], batch.opt, &batch.results[k]);
+	}
+	// the workers exit after the batch, their buffers go with them
+	sizerThreadDone();
+	writeThreadDone();
+	return NULL;
+}
+
+static int runBatch(const char *path, const run_options *opt, int workers){
+	// size every circuit of path on workers threads, then print one summary table
+	if(!batchFiles(path)) return 0;
+	batch.opt = opt;
+	batch.results = calloc(batch.n, sizeof(run_result));
+	workers = min(max(workers, 1), batch.n);
+	pthread_t *tid = malloc(workers * sizeof(pthread_t));
+
+	double t0 = wallTime();
+	for(int w = 1; w < workers; w++){
+		if(pthread_create(&tid[w], NULL, batchWorker, NULL) != 0){
+			printf("Error: cannot start batch worker %d\n", w);
+			exit(1);
+		}
+	}
+	batchWorker(NULL);
+	for(int w = 1; w < workers; w++) pthread_join(tid[w], NULL);
+	double t1 = wallTime();
 
-	fclose(pFile);
+	int failed = 0;
+	double busy = 0.0;
+	printf("%-32s %9s %10s %12s %12s %8s %10s\n", "circuit", "nodes", "delay", "area_before", "area_after", "slack", "runtime(s)");
+	for(int k = 0; k < batch.n; k++){
+		run_result *r = &batch.results[k];
+		if(!r->ok){
+			printf("%-32s failed\n", batch.files[k]);
+			failed++;
+		}else{
+			printf("%-32s %9u %10.3f %12.3f %12.3f %8.3f %10.4f\n", batch.files[k], r->nodes, r->initial_delay,
+				r->original_area, r->optimized_area, FIX_NEG_ZERO(r->worst_slack), r->runtime);
+			busy += r->runtime;
+		}
+		free(batch.files[k]);
+	}
+	printf("%d circuits, %d failed, %d workers, %.3f s wall, %.3f s summed\n", batch.n, failed, workers, t1 - t0, busy);
+
+	free(batch.files);
+	free(batch.results);
+	free(tid);
+	return failed == 0;
 }
 
 //***********************************************************
 int 
 main(int argc, char **argv)
 {
-	char circuit[100];			// input circuit name.
-	Abc_Ntk_t *ntk;
+	char *input = NULL;			// input circuit name.
+	char *batch_path = NULL;		// --batch <dir|list>: size many circuits in one process
+	char *serve_path = NULL;		// --serve <socket>: keep the library and a design resident for edits
+	char *profile = NULL;			// --profile <prefix>: phase/counter report to prefix.json and prefix.trace.json
+	long stitch_nodes = 0;			// --stitch N out.aig: stitch the input circuits into an N-node AIG
+	char *stitch_out = NULL;
+	char **inputs = malloc(argc * sizeof(char *));
+	int ninputs = 0;
+	int threads = 1;			// --threads N: threads for full timing passes, --batch: circuit workers
+	char *sta_kernel = NULL;		// --sta-kernel K: full pass kernel, NULL: the widest the CPU runs
+	run_options opt = {.sizer = SIZER_GREEDY, .sizer_time = 0.5, .threads = 1, .verbose = 1, .slack_on = 1, .restructure_time = 1.0};
+	timing_constraints constraints;		// --constraints F, --target T|Fx
+	defaultConstraints(&constraints);
 
-	printf("Process %s\n", argv[argc-1]);
-	
-	// << Setup ABC >>
-	Abc_Start();
-	
-  	// step1: << Read blif file and library file >>
-	strcpy(circuit, argv[argc-1]);
-  	if (!(ntk = Io_ReadBlifAsAig(circuit, 1))) return 1; 
-	parseLib();
-	sortLib();
-
-	// step2: << map AND to NAND+INV >>
-	mapping(ntk);
-	createnodes(ntk);
-	// sortNodes();
-
-	// step3: << calculate initial delay >>
-	initialDelay();
-	printf("NODE: %d INV: %d NAND: %d\n", node_count, _inv, nand);
-	printf("initial_delay: %f\noriginal_area: %f\n", _initial_delay, _original_area);
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+			threads = atoi(argv[++i]);
+		}else if(strcmp(argv[i], "--sta-bench") == 0 && i + 1 < argc){
+			opt.sta_bench = atoi(argv[++i]);
+		}else if(strcmp(argv[i], "--sta-kernel") == 0 && i + 1 < argc){
+			sta_kernel = argv[++i];
+		}else if(strcmp(argv[i], "--abc") == 0){
+			opt.use_abc = 1;
+		}else if(strcmp(argv[i], "--restructure") == 0){
+			opt.restructure = 1;
+		}else if(strcmp(argv[i], "--restructure-time") == 0 && i + 1 < argc){
+			opt.restructure = 1;
+			opt.restructure_time = atof(argv[++i]);
+		}else if(strcmp(argv[i], "--polarity") == 0){
+			opt.polarity = 1;
+		}else if(strcmp(argv[i], "--share-inv") == 0){
+			opt.share_inv = 1;
+		}else if(strcmp(argv[i], "--buffer-fanout") == 0 && i + 1 < argc){
+			opt.share_inv = 1;
+			opt.buffer_fanout = atoi(argv[++i]);
+			if(opt.buffer_fanout < 2){
+				printf("Error: --buffer-fanout needs at least 2\n");
+				return 1;
+			}
+		}else if(strcmp(argv[i], "--constraints") == 0 && i + 1 < argc){
+			if(!readConstraints(&constraints, argv[++i])) return 1;
+			opt.constraints = &constraints;
+		}else if(strcmp(argv[i], "--target") == 0 && i + 1 < argc){
+			if(!parseTarget(argv[++i], &constraints.target, &constraints.relative)){
+				printf("Error: bad target %s (a time or Fx)\n", argv[i]);
+				return 1;
+			}
+			opt.constraints = &constraints;
+		}else if(strcmp(argv[i], "--sweep") == 0 && i + 1 < argc){
+			opt.sweep = 1;
+			if(!parseSweep(argv[++i], &opt.sweep_lo, &opt.sweep_hi, &opt.sweep_step, &opt.sweep_relative) ||
+			   sweepPoints(&opt) > SWEEP_MAX){
+				printf("Error: bad sweep %s (lo:hi:step, times or Fx, at most %d targets)\n", argv[i], SWEEP_MAX);
+				return 1;
+			}
+		}else if(strcmp(argv[i], "--cache") == 0 && i + 1 < argc){
+			opt.cache = argv[++i];
+		}else if(strcmp(argv[i], "--verify") == 0){
+			opt.verify = 1;
+		}else if(strcmp(argv[i], "--binary") == 0){
+			opt.binary = 1;
+		}else if(strcmp(argv[i], "--report") == 0 && i + 1 < argc){
+			opt.report = atoi(argv[++i]);
+			if(opt.report < 1){
+				printf("Error: --report needs at least 1 path\n");
+				return 1;
+			}
+		}else if(strcmp(argv[i], "--no-slack") == 0){
+			opt.slack_on = 0;
+		}else if(strcmp(argv[i], "--profile") == 0 && i + 1 < argc){
+			profile = argv[++i];
+		}else if(strcmp(argv[i], "--stitch") == 0 && i + 2 < argc){
+			stitch_nodes = atol(argv[++i]);
+			stitch_out = argv[++i];
+		}else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc){
+			batch_path = argv[++i];
+		}else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc){
+			serve_path = argv[++i];
+		}else if(strcmp(argv[i], "--sizer") == 0 && i + 1 < argc){
+			i++;
+			if(strcmp(argv[i], "lr") == 0) opt.sizer = SIZER_LR;
+			else if(strcmp(argv[i], "dp") == 0) opt.sizer = SIZER_DP;
+			else if(strcmp(argv[i], "greedy") == 0) opt.sizer = SIZER_GREEDY;
+			else{
+				printf("Error: unknown sizer %s (greedy, lr, dp)\n", argv[i]);
+				return 1;
+			}
+		}else if(strcmp(argv[i], "--partitions") == 0 && i + 1 < argc){
+			opt.partitions = atoi(argv[++i]);
+			if(opt.partitions < 2){
+				printf("Error: --partitions needs at least 2 regions\n");
+				return 1;
+			}
+		}else if(strcmp(argv[i], "--sizer-time") == 0 && i + 1 < argc){
+			opt.sizer_time = atof(argv[++i]);
+		}else if(argv[i][0] == '-' && argv[i][1] == '-'){
+			printf("Error: unknown option %s\n", argv[i]);
+			input = NULL;
+			batch_path = NULL;
+			serve_path = NULL;
+			ninputs = 0;
+			break;
+		}else{
+			input = argv[i];
+			inputs[ninputs++] = argv[i];
+		}
+	}
+	if(stitch_out && ninputs > 0){
+		int ok = stitchCircuits(inputs, ninputs, stitch_nodes, stitch_out);
+		free(inputs);
+		freeConstraints(&constraints);
+		return ok ? 0 : 1;
+	}
+	free(inputs);
+	if((input != NULL) + (batch_path != NULL) + (serve_path != NULL) != 1 || ninputs > 1){
+		printf("usage: %s [--threads N] [--sta-bench N] [--sta-kernel auto|scalar|avx2|avx512] [--abc] [--sizer greedy|lr|dp] [--sizer-time S] [--partitions N] [--restructure] [--restructure-time S] [--polarity] [--share-inv] [--buffer-fanout N] [--constraints F] [--target T|Fx] [--sweep lo:hi:step] [--binary] [--no-slack] [--verify] [--cache DIR] [--report K] [--profile P] circuit.blif|circuit.aig\n", argv[0]);
+		printf("       %s [--threads N] [--sta-kernel auto|scalar|avx2|avx512] [--sizer greedy|lr|dp] [--sizer-time S] [--partitions N] [--restructure] [--restructure-time S] [--polarity] [--share-inv] [--buffer-fanout N] [--constraints F] [--target T|Fx] [--sweep lo:hi:step] [--binary] [--no-slack] [--verify] [--cache DIR] [--report K] [--profile P] --batch <dir|list>\n", argv[0]);
+		printf("       %s [--threads N] [--sta-kernel auto|scalar|avx2|avx512] [--constraints F] [--target T|Fx] [--no-slack] --serve SOCKET\n", argv[0]);
+		printf("       %s --stitch N out.aig circuit.blif|circuit.aig ...\n", argv[0]);
+		return 1;
+	}
+#ifndef ACE_USE_ABC
+	if(opt.use_abc){
+		printf("Error: --abc needs a build against libabc.a (make ABC=<path>)\n");
+		return 1;
+	}
+#endif
 
-	// step4: << optimize area using slack>>
-	optimization();
-	printf("optimized_area: %f\n", _optimized_area);
+	if(!staKernel(sta_kernel)){
+		printf("Error: timing kernel %s not available on this CPU\n", sta_kernel);
+		return 1;
+	}
+	if(profile) profStart();
 
-	// step5: << output >>
-	char *file_name;
-	file_name = strtok(argv[argc - 1], ".");
-	strcat(file_name, ".mbench");
-	Write(file_name, ntk);	
+	// the library is parsed once, its delay tables are shared by every circuit
+	if(!parseLib()){
+		freeConstraints(&constraints);
+		return 1;
+	}
+	sortLib();
 
-	// PrintEachObj(ntk);
+	if(batch_path){
+		if(opt.use_abc){
+			printf("Error: --abc can't be used with --batch\n");
+			return 1;
+		}
+		// circuits run in parallel, each one times its own graph serially
+		opt.verbose = 0;
+		opt.sta_bench = 0;
+		int ok = runBatch(batch_path, &opt, threads);
+		if(profile) profWrite(profile);
+		freeConstraints(&constraints);
+		return ok ? 0 : 1;
+	}
 
-	Abc_NtkDelete(ntk);
+	if(serve_path){
+		// designs are loaded by the clients, full passes use the threads
+		staThreads(threads);
+		int ok = serveSocket(serve_path, opt.constraints, opt.slack_on);
+		staThreads(1);
+		freeConstraints(&constraints);
+		return ok ? 0 : 1;
+	}
 
-	// << End ABC >>
-	Abc_Stop();
+	opt.threads = threads;
+	// with partitions the threads size regions, each timing its own graph serially
+	staThreads(opt.partitions > 1 ? 1 : threads);
+	// a failed read or write or a --verify mismatch is the exit status, 0 only for a clean run
+	int ok = runCircuit(input, &opt, &(run_result){0});
+	staThreads(1);
+	if(profile) profWrite(profile);
+	freeConstraints(&constraints);
 	
-	return 1;
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include "ace.h"
+
+// Partitioned sizing (--partitions N). The gates are cut into N balanced
+// regions, sized concurrently by the greedy pass of optimization() (after
+// sizeDP() with --sizer dp), each on a graph of its own built from the region
+// when a worker takes it:
+//   - regions are contiguous runs of a depth-first postorder from the outputs,
+//     so a region starts as a set of whole fanin cones, then a few refinement
+//     passes move a node to the region most of its neighbours are in while the
+//     sizes stay within PART_IMBALANCE of the average (fewer nets cut);
+//   - a net driven in one region and read in another gets a time budget from
+//     the global timing of the current cells: the driver's region must get it
+//     there by then (an output stub per outside reader, which also keeps the
+//     driver's load), the readers' regions take it as the arrival of an input;
+//   - the budget is arrival + alpha * slack with one alpha for every net. The
+//     arrival and the required times of one timing both meet every delay
+//     between two nets, so any mix of them with one alpha does too: the
+//     current cells meet every region's budgets and the greedy pass keeps
+//     whatever it is given met, so the circuit meets its target every round.
+// Every round splits what slack is left on the cut nets evenly between the two
+// sides (alpha 0.5) from the timing the last round left, while the area drops;
+// the cells of the smallest round are kept.
+// Regions are handed out largest first from a shared queue, so the workers
+// balance themselves. Only the region being sized is copied, so the memory
+// beyond the netlist is the workers times a region.
+
+#define PART_ROUNDS 8	// sizing rounds at most
+#define PART_ALPHA 0.5	// share of a cut net's slack its driver's region gets
+#define PART_GAIN 1e-4	// relative area gain below which the rounds stop
+#define PART_IMBALANCE 0.05	// refinement: region sizes stay within this of the average
+#define PART_PASSES 4	// refinement passes at most
+
+typedef struct part_state{
+	timing_graph *g;
+	int parts;
+	int *part;	// region of every node, -1: PI
+	int *first;	// nodes of region p: nodes[first[p]] .. nodes[first[p+1]-1], in index order
+	int *nodes;
+	double target;
+	double alpha;	// budget of a cut net: arrival + alpha * slack
+	int exact;	// sizeDP() on every region before the greedy pass
+	int *queue;	// regions by decreasing size
+	int next;	// next queue entry to hand out
+	pthread_mutex_t lock;
+} part_state;
+
+//***********************************************************
+// partitioning
+static int postorder(timing_graph *g, int *order){
+	// gates and outputs depth first from the outputs, fanins before their readers;
+	// nodes no output reads come after. Returns the count
+	unsigned char *seen = calloc(g->n, 1);
+	int *stack = malloc(g->n * sizeof(int)), *pin = malloc(g->n * sizeof(int));
+	if(!seen || !stack || !pin){
+		printf("Error: out of memory for partitioning\n");
+		exit(1);
+	}
+	int n = 0;
+	for(int pass = 0; pass < 2; pass++){
+		for(unsigned int root = 0; root < g->n; root++){
+			if(seen[root] || g->type[root] == PI || (pass == 0 && g->type[root] != PO)) continue;
+			int top = 0;
+			seen[root] = 1;
+			stack[top] = root;
+			pin[top++] = 0;
+			while(top > 0){
+				int v = stack[top - 1];
+				int fanins = g->type[v] == PI || g->fanin0[v] < 0 ? 0 : g->type[v] == GATE ? 2 : 1;
+				if(pin[top - 1] < fanins){
+					int f = pin[top - 1]++ == 0 ? g->fanin0[v] : g->fanin1[v];
+					if(seen[f]) continue;
+					seen[f] = 1;
+					stack[top] = f;
+					pin[top++] = 0;
+					continue;
+				}
+				top--;
+				if(g->type[v] != PI) order[n++] = v;
+			}
+		}
+	}
+	free(seen);
+	free(stack);
+	free(pin);
+	return n;
+}
+
+static void refine(part_state *s, const int *order, int n, int *size){
+	// move nodes to the region most of their neighbours are in, sizes kept balanced
+	timing_graph *g = s->g;
+	int *count = calloc(s->parts, sizeof(int)), *seen = malloc(s->parts * sizeof(int));
+	if(!count || !seen){
+		printf("Error: out of memory for partitioning\n");
+		exit(1);
+	}
+	double average = (double)n / s->parts;
+	int hi = (int)(average * (1.0 + PART_IMBALANCE)) + 1, lo = (int)(average * (1.0 - PART_IMBALANCE));
+	for(int pass = 0; pass < PART_PASSES; pass++){
+		int moved = 0;
+		for(int k = 0; k < n; k++){
+			int v = order[k], p = s->part[v], nseen = 0;
+			for(int e = -2; e < FANOUT_NUM(g, v); e++){
+				// the fanins, then the readers
+				int u = e == -2 ? g->fanin0[v] : e == -1 ? (g->type[v] == GATE ? g->fanin1[v] : -1) : g->fanout[g->fanout_start[v] + e];
+				if(u < 0 || s->part[u] < 0) continue;
+				if(count[s->part[u]]++ == 0) seen[nseen++] = s->part[u];
+			}
+			int best = p;
+			for(int j = 0; j < nseen; j++){
+				int q = seen[j];
+				if(count[q] > count[best] && size[q] < hi) best = q;
+			}
+			for(int j = 0; j < nseen; j++) count[seen[j]] = 0;
+			if(best == p || size[p] <= lo) continue;
+			s->part[v] = best;
+			size[p]--;
+			size[best]++;
+			moved++;
+		}
+		if(moved == 0) break;
+	}
+	free(count);
+	free(seen);
+}
+
+static int partitionGraph(part_state *s){
+	// regions of every gate and output, returns the nets cut
+	timing_graph *g = s->g;
+	int *order = malloc(max(g->n, 1) * sizeof(int));
+	s->part = malloc(max(g->n, 1) * sizeof(int));
+	if(!order || !s->part){
+		printf("Error: out of memory for partitioning\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < g->n; i++) s->part[i] = -1;
+	int n = postorder(g, order);
+	s->parts = max(min(s->parts, n), 1);
+	int *size = calloc(s->parts, sizeof(int));
+	for(int k = 0; k < n; k++){
+		int p = (int)((long)k * s->parts / n);
+		s->part[order[k]] = p;
+		size[p]++;
+	}
+	refine(s, order, n, size);
+
+	// nodes per region in index order, so each region is topologically ordered
+	s->first = calloc(s->parts + 1, sizeof(int));
+	s->nodes = malloc(max(n, 1) * sizeof(int));
+	for(int p = 0; p < s->parts; p++) s->first[p + 1] = s->first[p] + size[p];
+	memcpy(size, s->first, s->parts * sizeof(int));
+	for(unsigned int i = 0; i < g->n; i++) if(s->part[i] >= 0) s->nodes[size[s->part[i]]++] = i;
+	// largest first, they bound the wall time
+	s->queue = malloc(s->parts * sizeof(int));
+	for(int p = 0; p < s->parts; p++) s->queue[p] = p;
+	for(int a = 1; a < s->parts; a++){
+		int p = s->queue[a], b = a;
+		for(; b > 0 && s->first[s->queue[b-1] + 1] - s->first[s->queue[b-1]] < s->first[p + 1] - s->first[p]; b--) s->queue[b] = s->queue[b-1];
+		s->queue[b] = p;
+	}
+	int cut = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(s->part[i] < 0) continue;
+		for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+			if(s->part[g->fanout[k]] == s->part[i]) continue;
+			cut++;
+			break;
+		}
+	}
+	free(order);
+	free(size);
+	return cut;
+}
+
+//***********************************************************
+// sizing a region
+static double budget(part_state *s, int i){
+	// the time a cut net is due at / taken to arrive at
+	timing_graph *g = s->g;
+	return g->arrival[i] + s->alpha * (g->required[i] - g->arrival[i]);
+}
+
+static void sizeRegion(part_state *s, int p, int *local){
+	// build region p as a graph of its own, size it and hand the cells back; local[] is -1
+	// for every node and is left so
+	timing_graph *g = s->g;
+	timing_graph h;
+	memset(&h, 0, sizeof(h));
+	const int *node = s->nodes + s->first[p];
+	int n = s->first[p + 1] - s->first[p];
+	graphReserve(&h, 2 * n + 16);
+	double *port = NULL;
+	int port_cap = 0;
+#define PORT(id, t) do{ \
+		if((id) >= port_cap){ \
+			port_cap = 2 * (id) + 64; \
+			port = realloc(port, port_cap * sizeof(double)); \
+			if(!port){ printf("Error: out of memory for partitioning\n"); exit(1); } \
+		} \
+		port[id] = (t); \
+	}while(0)
+
+	// inputs: PIs and nets cut on the way in
+	for(int k = 0; k < n; k++){
+		int v = node[k];
+		for(int pin = 0; pin < (g->type[v] == GATE ? 2 : 1); pin++){
+			int f = pin == 0 ? g->fanin0[v] : g->fanin1[v];
+			if(f < 0 || s->part[f] == p || local[f] >= 0) continue;
+			local[f] = graphAddNode(&h, PI, -1, -1, 0, NULL);
+			h.arrival[local[f]] = g->type[f] == PI ? g->arrival[f] : budget(s, f);
+			PORT(local[f], h.arrival[local[f]]);
+		}
+	}
+	for(int k = 0; k < n; k++){
+		int v = node[k];
+		int f0 = g->fanin0[v] >= 0 ? local[g->fanin0[v]] : -1;
+		int f1 = g->type[v] == GATE ? local[g->fanin1[v]] : -1;
+		int i = local[v] = graphAddNode(&h, g->type[v], f0, f1, g->compl[v], NULL);
+		h.nand_id[i] = g->nand_id[v];
+		h.inv0_id[i] = g->inv0_id[v];
+		h.inv1_id[i] = g->inv1_id[v];
+		PORT(i, g->type[v] == PO ? PO_REQUIRED(g, v, s->target) : 0.0);
+	}
+	// an output stub per reader outside: the net's load, required at its budget
+	for(int k = 0; k < n; k++){
+		int v = node[k];
+		for(int e = g->fanout_start[v]; e < g->fanout_start[v+1]; e++){
+			if(s->part[g->fanout[e]] == p) continue;
+			int i = graphAddNode(&h, PO, local[v], -1, 0, NULL);
+			PORT(i, budget(s, v));
+		}
+	}
+#undef PORT
+	graphBuildFanouts(&h);
+	graphBuildLevels(&h);
+	h.port_time = port;
+	h.initial_delay = s->target;
+	staFull(&h, s->target);
+	if(s->exact) sizeDP(&h, s->target);
+	optimization(&h);
+	for(int k = 0; k < n; k++){
+		int v = node[k];
+		g->nand_id[v] = h.nand_id[local[v]];
+		g->inv0_id[v] = h.inv0_id[local[v]];
+		g->inv1_id[v] = h.inv1_id[local[v]];
+	}
+	for(int k = 0; k < n; k++){
+		int v = node[k];
+		local[v] = -1;
+		if(g->fanin0[v] >= 0) local[g->fanin0[v]] = -1;
+		if(g->type[v] == GATE) local[g->fanin1[v]] = -1;
+	}
+	graphFree(&h);
+}
+
+static void *regionWorker(void *arg){
+	part_state *s = arg;
+	int *local = malloc(max(s->g->n, 1) * sizeof(int));
+	if(!local){
+		printf("Error: out of memory for partitioning\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < s->g->n; i++) local[i] = -1;
+	while(1){
+		pthread_mutex_lock(&s->lock);
+		int k = s->next++;
+		pthread_mutex_unlock(&s->lock);
+		if(k >= s->parts) break;
+		sizeRegion(s, s->queue[k], local);
+	}
+	free(local);
+	// the workers of a round exit, their sizeDP() arenas go with them
+	sizerThreadDone();
+	return NULL;
+}
+
+//***********************************************************
+int sizePartitions(timing_graph *g, double target, int parts, int workers, int exact, int verbose){
+	// in place of optimization(), full passes serial (staThreads(1)); exact: --sizer dp on the
+	// regions first. Returns the rounds run
+	double t0 = wallTime();
+	part_state s = {g, parts};
+	s.target = target;
+	s.alpha = PART_ALPHA;
+	s.exact = exact;
+	pthread_mutex_init(&s.lock, NULL);
+	int cut = partitionGraph(&s);
+	if(verbose){
+		int lo = INT_MAX, hi = 0, nets = 0;
+		for(int p = 0; p < s.parts; p++){
+			lo = min(lo, s.first[p + 1] - s.first[p]);
+			hi = max(hi, s.first[p + 1] - s.first[p]);
+		}
+		for(unsigned int i = 0; i < g->n; i++) nets += s.part[i] >= 0 && FANOUT_NUM(g, i) > 0;
+		printf("partitions: %d regions of %d .. %d nodes, %d of %d nets cut (%.1f%%) in %.3f s\n", s.parts, lo, hi, cut,
+			nets, 100.0 * cut / max(nets, 1), wallTime() - t0);
+	}
+	workers = min(max(workers, 1), s.parts);
+	pthread_t *tid = malloc(workers * sizeof(pthread_t));
+	// the cells of the smallest round, a round can come out a little larger
+	short *best = malloc(3 * (size_t)max(g->n, 1) * sizeof(short));
+	if(!best){
+		printf("Error: out of memory for partitioning\n");
+		exit(1);
+	}
+	double area = graphArea(g), best_area = DBL_MAX;
+	int round;
+	for(round = 1; round <= PART_ROUNDS; round++){
+		double t_round = wallTime();
+		// the timing of the current cells, the budgets come from it
+		staFull(g, target);
+		s.next = 0;
+		for(int w = 1; w < workers; w++){
+			if(pthread_create(&tid[w], NULL, regionWorker, &s) != 0){
+				printf("Error: cannot start partition worker %d\n", w);
+				exit(1);
+			}
+		}
+		regionWorker(&s);
+		for(int w = 1; w < workers; w++) pthread_join(tid[w], NULL);
+		double before = area;
+		area = graphArea(g);
+		if(verbose){
+			staFull(g, target);
+			double worst = DBL_MAX;
+			for(unsigned int i = 0; i < g->n; i++){
+				if(g->type[i] == PO && g->fanin0[i] >= 0) worst = min(worst, PO_REQUIRED(g, i, target) - g->arrival[i]);
+			}
+			printf("partitions round %d: area %.3f, worst slack %.3f, %d workers, %.3f s\n", round, area, FIX_NEG_ZERO(worst == DBL_MAX ? target : worst), workers,
+				wallTime() - t_round);
+		}
+		if(area < best_area){
+			best_area = area;
+			memcpy(best, g->nand_id, g->n * sizeof(short));
+			memcpy(best + g->n, g->inv0_id, g->n * sizeof(short));
+			memcpy(best + 2 * g->n, g->inv1_id, g->n * sizeof(short));
+		}
+		// without cut nets the regions are independent and one round is final
+		if(cut == 0 || (round > 1 && before - area < PART_GAIN * before)) break;
+	}
+	if(area > best_area){
+		memcpy(g->nand_id, best, g->n * sizeof(short));
+		memcpy(g->inv0_id, best + g->n, g->n * sizeof(short));
+		memcpy(g->inv1_id, best + 2 * g->n, g->n * sizeof(short));
+		area = best_area;
+	}
+	free(best);
+	staFull(g, target);
+	staSlacks(g);
+	g->optimized_area = area;
+	pthread_mutex_destroy(&s.lock);
+	free(tid);
+	free(s.part);
+	free(s.first);
+	free(s.nodes);
+	free(s.queue);
+	return min(round, PART_ROUNDS);
+}
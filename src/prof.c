@@ -0,0 +1,172 @@
+#include <pthread.h>
+#include "ace.h"
+
+// Phase timers and hot-path counters (--profile). Phases are scoped by
+// profBegin()/profEnd() on the calling thread and may nest; each finished
+// phase is recorded with its wall time and the counter deltas it covers.
+// Counters are per thread, so the hot loops bump them without atomics, and
+// every counter site tests prof_on first: disabled, a phase costs one branch
+// and a counter one predictable branch. Full timing passes are counted by
+// their caller, the pool threads never touch the counters.
+
+#define PROF_DEPTH 16	// nested phases per thread
+
+static const char *counter_names[PROF_COUNTERS] = {
+	"nodes_visited", "cells_evaluated", "cells_swapped", "inverters_inserted", "inverters_removed"
+};
+
+typedef struct prof_event{
+	const char *phase;
+	char *circuit;
+	int tid;
+	int depth;
+	double start;	// seconds since profStart()
+	double time;
+	long count[PROF_COUNTERS];
+} prof_event;
+
+int prof_on = 0;
+__thread long prof_count[PROF_COUNTERS];
+
+static struct{
+	double t0;
+	prof_event *events;
+	int n, cap;
+	int threads;	// thread ids handed out
+	pthread_mutex_t lock;
+} prof = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static __thread struct{
+	int tid;	// 0: not assigned yet
+	const char *circuit;
+	int depth;
+	const char *phase[PROF_DEPTH];
+	double start[PROF_DEPTH];
+	long count[PROF_DEPTH][PROF_COUNTERS];
+} local;
+
+void profStart(){
+	prof_on = 1;
+	prof.t0 = wallTime();
+}
+
+void profCircuit(const char *circuit){
+	// circuit the following phases of this thread belong to
+	local.circuit = circuit;
+}
+
+void profBegin(const char *phase){
+	if(!prof_on) return;
+	if(local.depth == PROF_DEPTH){
+		printf("Error: profile phases nested deeper than %d\n", PROF_DEPTH);
+		exit(1);
+	}
+	local.phase[local.depth] = phase;
+	memcpy(local.count[local.depth], prof_count, sizeof(prof_count));
+	local.start[local.depth++] = wallTime();
+}
+
+void profEnd(){
+	if(!prof_on || local.depth == 0) return;
+	double now = wallTime();
+	int d = --local.depth;
+	prof_event e;
+	e.phase = local.phase[d];
+	e.circuit = local.circuit ? strdup(local.circuit) : NULL;
+	e.depth = d;
+	e.start = local.start[d] - prof.t0;
+	e.time = now - local.start[d];
+	for(int c = 0; c < PROF_COUNTERS; c++) e.count[c] = prof_count[c] - local.count[d][c];
+
+	pthread_mutex_lock(&prof.lock);
+	if(local.tid == 0) local.tid = ++prof.threads;
+	e.tid = local.tid;
+	if(prof.n == prof.cap){
+		prof.cap = prof.cap * 2 + 64;
+		prof.events = realloc(prof.events, prof.cap * sizeof(prof_event));
+	}
+	prof.events[prof.n++] = e;
+	pthread_mutex_unlock(&prof.lock);
+}
+
+static void jsonString(FILE *file, const char *s){
+	putc('"', file);
+	for(; s && *s; s++){
+		if(*s == '"' || *s == '\\') putc('\\', file);
+		if((unsigned char)*s < 0x20) fprintf(file, "\\u%04x", *s);
+		else putc(*s, file);
+	}
+	putc('"', file);
+}
+
+static void jsonCounters(FILE *file, const long *count){
+	for(int c = 0; c < PROF_COUNTERS; c++){
+		fprintf(file, ", \"%s\": %ld", counter_names[c], count[c]);
+	}
+}
+
+int profWrite(const char *prefix){
+	// prefix.json: phases with times and counters, totals of the outermost phases;
+	// prefix.trace.json: Chrome trace events (chrome://tracing, Perfetto). Returns 0 on error
+	if(!prof_on) return 1;
+	double wall = wallTime() - prof.t0;
+	char *file_name = malloc(strlen(prefix) + 16);
+
+	sprintf(file_name, "%s.json", prefix);
+	FILE *file = fopen(file_name, "w");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		free(file_name);
+		return 0;
+	}
+	long total[PROF_COUNTERS] = {0};
+	fprintf(file, "{\n  \"wall_ms\": %.3f,\n  \"threads\": %d,\n  \"phases\": [\n", wall * 1e3, prof.threads);
+	for(int k = 0; k < prof.n; k++){
+		prof_event *e = &prof.events[k];
+		fprintf(file, "    {\"circuit\": ");
+		jsonString(file, e->circuit);
+		fprintf(file, ", \"phase\": ");
+		jsonString(file, e->phase);
+		fprintf(file, ", \"thread\": %d, \"depth\": %d, \"start_ms\": %.3f, \"time_ms\": %.3f", e->tid, e->depth,
+			e->start * 1e3, e->time * 1e3);
+		jsonCounters(file, e->count);
+		fprintf(file, "}%s\n", k + 1 < prof.n ? "," : "");
+		if(e->depth == 0){
+			for(int c = 0; c < PROF_COUNTERS; c++) total[c] += e->count[c];
+		}
+	}
+	fprintf(file, "  ],\n  \"totals\": {\"phases\": %d", prof.n);
+	jsonCounters(file, total);
+	fprintf(file, "}\n}\n");
+	fclose(file);
+
+	sprintf(file_name, "%s.trace.json", prefix);
+	file = fopen(file_name, "w");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		free(file_name);
+		return 0;
+	}
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for(int k = 0; k < prof.n; k++){
+		prof_event *e = &prof.events[k];
+		fprintf(file, "  {\"name\": ");
+		jsonString(file, e->phase);
+		fprintf(file, ", \"cat\": ");
+		jsonString(file, e->circuit);
+		fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"circuit\": ",
+			e->tid, e->start * 1e6, e->time * 1e6);
+		jsonString(file, e->circuit);
+		jsonCounters(file, e->count);
+		fprintf(file, "}}%s\n", k + 1 < prof.n ? "," : "");
+	}
+	fprintf(file, "]}\n");
+	fclose(file);
+
+	for(int k = 0; k < prof.n; k++) free(prof.events[k].circuit);
+	free(prof.events);
+	prof.events = NULL;
+	prof.n = prof.cap = 0;
+	free(file_name);
+	return 1;
+}
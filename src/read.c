@@ -0,0 +1,614 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ace.h"
+
+// Native netlist reader: BLIF (.names covers) and binary AIGER.
+// The file is read in one pass into a compact net table; the AIG is then
+// strashed straight into the timing graph by an iterative DFS from the
+// outputs, so nodes come out in the same order ABC's Io_ReadBlifAsAig()
+// would create them (PIs, AND nodes in DFS order, POs) and no intermediate
+// network is built. Literals are 2*(node index + 1) + complement, 0 and 1
+// are the constants.
+
+#define LIT_CONST0 0
+#define LIT_CONST1 1
+#define LIT_NODE(lit) (((lit) >> 1) - 1)
+#define LIT_NOT(lit) ((lit) ^ 1)
+
+typedef struct net{
+	int name;	// offset of the name in reader.names
+	int lit;	// strashed literal / -1: not built yet
+	int nin;	// BLIF: cover inputs, AIGER: 2 / -1: net is not driven
+	int fanin;	// offset of the cover inputs in reader.fanins
+	int ncube;
+	char value;	// BLIF: output column of the cover ('1' onset, '0' offset)
+	size_t cube;	// BLIF: offset of the cover rows in reader.cubes
+} net;
+
+typedef struct net_slot{
+	int id;	// net id / -1: empty
+	unsigned int hash;	// full hash of the name, compared before the name itself
+} net_slot;
+
+typedef struct reader{
+	timing_graph *g;
+	net *nets;
+	size_t nnet, capnet;
+	char *names;	// interned net names, NUL terminated, one allocation for all nets
+	size_t nnames, capnames;
+	int *fanins;	// cover inputs as net ids, AIGER: two literals
+	size_t nfanin, capfanin;
+	char *cubes;	// cover rows, nin characters each
+	size_t ncubes, capcubes;
+	net_slot *net_table;	// open addressing name -> net id
+	int net_table_size;
+	int *and_table;	// open addressing (lit0, lit1) -> literal of the AND node
+	int and_table_size, nand;
+	int *pis, npi;
+	int *pos, npo;
+} reader;
+
+#define NET_NAME(r, n) ((r)->names + (n)->name)
+
+static void *growArray(void *p, size_t *cap, size_t need, size_t elem){
+	if(need <= *cap) return p;
+	size_t cap_new = max(need, *cap * 2 + 16);
+	p = realloc(p, cap_new * elem);
+	if(!p){
+		printf("Error: out of memory while reading netlist\n");
+		exit(1);
+	}
+	*cap = cap_new;
+	return p;
+}
+
+static unsigned int hashString(const char *s, int len){
+	unsigned int h = 2166136261u;
+	for(int k = 0; k < len; k++) h = (h ^ (unsigned char)s[k]) * 16777619u;
+	return h;
+}
+
+static void rehashNets(reader *r){
+	int size = r->net_table_size ? r->net_table_size * 2 : 1024;
+	net_slot *old = r->net_table;
+	r->net_table = malloc(size * sizeof(*r->net_table));
+	if(!r->net_table){
+		printf("Error: out of memory while reading netlist\n");
+		exit(1);
+	}
+	memset(r->net_table, -1, size * sizeof(*r->net_table));
+	for(int k = 0; k < r->net_table_size; k++){
+		if(old[k].id < 0) continue;
+		unsigned int h = old[k].hash & (size - 1);
+		while(r->net_table[h].id >= 0) h = (h + 1) & (size - 1);
+		r->net_table[h] = old[k];
+	}
+	free(old);
+	r->net_table_size = size;
+}
+
+static int addName(reader *r, const char *name, int len){
+	// append name to the arena, returns its offset
+	if(r->nnames + len + 1 > INT_MAX){
+		printf("Error: net names exceed %d bytes\n", INT_MAX);
+		exit(1);
+	}
+	r->names = growArray(r->names, &r->capnames, r->nnames + len + 1, 1);
+	int offset = r->nnames;
+	memcpy(r->names + offset, name, len);
+	r->names[offset + len] = '\0';
+	r->nnames += len + 1;
+	return offset;
+}
+
+static int addNet(reader *r, int name){
+	// new undriven net, not entered in the name table
+	r->nets = growArray(r->nets, &r->capnet, r->nnet + 1, sizeof(net));
+	net *n = &r->nets[r->nnet];
+	n->name = name;
+	n->lit = -1;
+	n->nin = -1;
+	n->fanin = n->cube = n->ncube = 0;
+	n->value = '1';
+	return r->nnet++;
+}
+
+static int findNet(reader *r, const char *name, int len){
+	// net id of name[0..len), interned on first use
+	if(2 * (r->nnet + 1) > (size_t)r->net_table_size) rehashNets(r);
+	unsigned int hash = hashString(name, len);
+	unsigned int h = hash & (r->net_table_size - 1);
+	while(r->net_table[h].id >= 0){
+		if(r->net_table[h].hash == hash){
+			const char *other = NET_NAME(r, &r->nets[r->net_table[h].id]);
+			if(memcmp(other, name, len) == 0 && other[len] == '\0') return r->net_table[h].id;
+		}
+		h = (h + 1) & (r->net_table_size - 1);
+	}
+	r->net_table[h].hash = hash;
+	r->net_table[h].id = addNet(r, addName(r, name, len));
+	return r->net_table[h].id;
+}
+
+//***********************************************************
+// strashing
+static int addAnd(reader *r, int a, int b){
+	// structurally hashed AND of two literals, trivial cases folded
+	if(a == LIT_CONST0 || b == LIT_CONST0) return LIT_CONST0;
+	if(a == LIT_CONST1) return b;
+	if(b == LIT_CONST1) return a;
+	if(a == b) return a;
+	if(a == LIT_NOT(b)) return LIT_CONST0;
+	// fanin0 is the older node, as in Abc_AigAnd()
+	if((a >> 1) > (b >> 1)){
+		int t = a;
+		a = b;
+		b = t;
+	}
+
+	if(2 * (r->nand + 1) > r->and_table_size){
+		int size = r->and_table_size ? r->and_table_size * 2 : 4096;
+		int *table = malloc(size * sizeof(int));
+		if(!table){
+			printf("Error: out of memory while reading netlist\n");
+			exit(1);
+		}
+		memset(table, -1, size * sizeof(int));
+		for(int k = 0; k < r->and_table_size; k++){
+			int lit = r->and_table[k];
+			if(lit < 0) continue;
+			int node = LIT_NODE(lit);
+			unsigned int h = ((unsigned int)(2 * (r->g->fanin0[node] + 1) + COMPL0(r->g, node)) * 2654435761u ^
+			                  (unsigned int)(2 * (r->g->fanin1[node] + 1) + COMPL1(r->g, node)) * 40503u) & (size - 1);
+			while(table[h] >= 0) h = (h + 1) & (size - 1);
+			table[h] = lit;
+		}
+		free(r->and_table);
+		r->and_table = table;
+		r->and_table_size = size;
+	}
+
+	unsigned int h = ((unsigned int)a * 2654435761u ^ (unsigned int)b * 40503u) & (r->and_table_size - 1);
+	while(r->and_table[h] >= 0){
+		int node = LIT_NODE(r->and_table[h]);
+		if(r->g->fanin0[node] == LIT_NODE(a) && COMPL0(r->g, node) == (a & 1) &&
+		   r->g->fanin1[node] == LIT_NODE(b) && COMPL1(r->g, node) == (b & 1))
+			return r->and_table[h];
+		h = (h + 1) & (r->and_table_size - 1);
+	}
+	int node = graphAddNode(r->g, GATE, LIT_NODE(a), LIT_NODE(b), (a & 1) | ((b & 1) << 1), NULL);
+	r->and_table[h] = 2 * (node + 1);
+	r->nand++;
+	return 2 * (node + 1);
+}
+
+static int coverLit(reader *r, net *n, int *fanin_lit){
+	// sum of products, cubes and literals left to right
+	int sum = LIT_CONST0;
+	for(int c = 0; c < n->ncube; c++){
+		const char *cube = r->cubes + n->cube + c * n->nin;
+		int product = LIT_CONST1;
+		for(int k = 0; k < n->nin; k++){
+			if(cube[k] == '1') product = addAnd(r, product, fanin_lit[k]);
+			else if(cube[k] == '0') product = addAnd(r, product, LIT_NOT(fanin_lit[k]));
+		}
+		sum = LIT_NOT(addAnd(r, LIT_NOT(sum), LIT_NOT(product)));
+	}
+	return n->value == '0' ? LIT_NOT(sum) : sum;
+}
+
+static int buildNet(reader *r, int root, int aiger){
+	// iterative post-order DFS, a net is strashed once all its fanins are; returns -1 on error
+	int *stack = NULL, nstack = 0, ok = 1;
+	int *lits = NULL;
+	size_t capstack = 0, caplits = 0;
+	stack = growArray(stack, &capstack, 1, sizeof(int));
+	stack[nstack++] = root;
+	while(ok && nstack > 0){
+		net *n = &r->nets[stack[nstack - 1]];
+		if(n->lit >= 0){
+			nstack--;
+			continue;
+		}
+		if(n->nin < 0){
+			printf("Error: net %s is used but never driven\n", NET_NAME(r, n));
+			ok = 0;
+			break;
+		}
+		if(n->lit == -2){
+			// second visit, all fanins are built
+			lits = growArray(lits, &caplits, n->nin + 1, sizeof(int));
+			if(aiger){
+				for(int k = 0; k < 2; k++){
+					int lit = r->fanins[n->fanin + k];
+					lits[k] = r->nets[lit >> 1].lit ^ (lit & 1);
+				}
+				n->lit = addAnd(r, lits[0], lits[1]);
+			}else{
+				for(int k = 0; k < n->nin; k++) lits[k] = r->nets[r->fanins[n->fanin + k]].lit;
+				n->lit = coverLit(r, n, lits);
+			}
+			nstack--;
+			continue;
+		}
+		n->lit = -2;
+		// push fanins in reverse so the first fanin is built first
+		int nin = aiger ? 2 : n->nin;
+		for(int k = nin - 1; k >= 0; k--){
+			int fanin = r->fanins[n->fanin + k];
+			if(aiger) fanin >>= 1;
+			if(r->nets[fanin].lit == -2){
+				printf("Error: combinational loop through net %s\n", NET_NAME(r, &r->nets[fanin]));
+				ok = 0;
+				break;
+			}
+			if(r->nets[fanin].lit >= 0) continue;
+			stack = growArray(stack, &capstack, nstack + 1, sizeof(int));
+			stack[nstack++] = fanin;
+		}
+	}
+	free(stack);
+	free(lits);
+	return ok ? r->nets[root].lit : -1;
+}
+
+static int buildGraph(reader *r, int aiger){
+	// PIs, then AND nodes in DFS order from the outputs, then POs; returns 0 on error
+	timing_graph *g = r->g;
+	for(int k = 0; k < r->npi; k++){
+		net *n = &r->nets[r->pis[k]];
+		n->lit = 2 * (graphAddNode(g, PI, -1, -1, 0, strdup(NET_NAME(r, n))) + 1);
+	}
+	int *po_lit = malloc((r->npo + 1) * sizeof(int));
+	for(int k = 0; k < r->npo; k++){
+		po_lit[k] = buildNet(r, r->pos[k], aiger);
+		if(po_lit[k] < 0){
+			free(po_lit);
+			return 0;
+		}
+	}
+	for(int k = 0; k < r->npo; k++){
+		net *n = &r->nets[r->pos[k]];
+		// a constant output gets fanin0 -1 and its value in the compl bit
+		graphAddNode(g, PO, LIT_NODE(po_lit[k]), -1, po_lit[k] & 1, strdup(NET_NAME(r, n)));
+	}
+	free(po_lit);
+	return 1;
+}
+
+static void readerFree(reader *r){
+	free(r->nets);
+	free(r->names);
+	free(r->fanins);
+	free(r->cubes);
+	free(r->net_table);
+	free(r->and_table);
+	free(r->pis);
+	free(r->pos);
+}
+
+//***********************************************************
+// input buffer
+// The file is mapped read-only and tokenized in place: tokens are (pointer,
+// length) pairs into the mapping and only net names are copied, once, into
+// the name arena.
+typedef struct cursor{
+	const char *p;
+	const char *end;
+} cursor;
+
+static int isContinuation(const char *p, const char *end){
+	// '\' at the end of a line joins it with the next one
+	return *p == '\\' && (p + 1 == end || p[1] == '\n' || (p[1] == '\r' && (p + 2 == end || p[2] == '\n')));
+}
+
+static int blifToken(cursor *c, const char **token){
+	// next token of the current logical line, returns its length / 0 at the end of the line
+	const char *p = c->p, *end = c->end;
+	while(p < end){
+		if(*p == ' ' || *p == '\t' || *p == '\r'){
+			p++;
+		}else if(isContinuation(p, end)){
+			while(p < end && *p != '\n') p++;
+			if(p < end) p++;
+		}else{
+			break;
+		}
+	}
+	*token = p;
+	if(p < end && *p == '#'){
+		// comment up to the end of the line
+		while(p < end && *p != '\n') p++;
+		c->p = p;
+		return 0;
+	}
+	while(p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#' && !isContinuation(p, end)) p++;
+	c->p = p;
+	return p - *token;
+}
+
+static void blifNextLine(cursor *c){
+	// skip what is left of the logical line
+	const char *token;
+	while(blifToken(c, &token) > 0);
+	while(c->p < c->end && *c->p != '\n') c->p++;
+	if(c->p < c->end) c->p++;
+}
+
+static int tokenIs(const char *token, int len, const char *word){
+	return (int)strlen(word) == len && memcmp(token, word, len) == 0;
+}
+
+//***********************************************************
+// BLIF
+static int readBlif(reader *r, cursor *c){
+	int cur = -1; // net whose cover rows are being read
+	int *ids = NULL;
+	size_t capids = 0, cappi = 0, cappo = 0;
+	const char *token;
+	int len;
+	for(; c->p < c->end; blifNextLine(c)){
+		if((len = blifToken(c, &token)) == 0) continue;
+		if(token[0] != '.'){
+			// cover row of the current .names
+			if(cur < 0) continue;
+			net *n = &r->nets[cur];
+			const char *out;
+			int len_out = blifToken(c, &out);
+			if(n->nin == 0){
+				out = token;
+				len_out = len;
+				len = 0;
+			}
+			if(len_out == 0 || len != n->nin){
+				printf("Error: bad cover row for net %s\n", NET_NAME(r, n));
+				free(ids);
+				return 0;
+			}
+			r->cubes = growArray(r->cubes, &r->capcubes, r->ncubes + n->nin, 1);
+			memcpy(r->cubes + r->ncubes, token, n->nin);
+			r->ncubes += n->nin;
+			n->ncube++;
+			n->value = out[0];
+			continue;
+		}
+		cur = -1;
+		if(tokenIs(token, len, ".inputs")){
+			while((len = blifToken(c, &token)) > 0){
+				r->pis = growArray(r->pis, &cappi, r->npi + 1, sizeof(int));
+				int id = findNet(r, token, len);
+				r->nets[id].nin = 0; // driven by the PI, buildGraph() numbers it
+				r->pis[r->npi++] = id;
+			}
+		}else if(tokenIs(token, len, ".outputs")){
+			while((len = blifToken(c, &token)) > 0){
+				r->pos = growArray(r->pos, &cappo, r->npo + 1, sizeof(int));
+				r->pos[r->npo++] = findNet(r, token, len);
+			}
+		}else if(tokenIs(token, len, ".names")){
+			int nids = 0;
+			while((len = blifToken(c, &token)) > 0){
+				ids = growArray(ids, &capids, nids + 1, sizeof(int));
+				ids[nids++] = findNet(r, token, len);
+			}
+			if(nids == 0) continue;
+			cur = ids[nids - 1];
+			net *n = &r->nets[cur];
+			if(n->nin >= 0){
+				printf("Error: net %s is driven twice\n", NET_NAME(r, n));
+				free(ids);
+				return 0;
+			}
+			n->nin = nids - 1;
+			n->fanin = r->nfanin;
+			n->cube = r->ncubes;
+			n->ncube = 0;
+			n->value = '1';
+			r->fanins = growArray(r->fanins, &r->capfanin, r->nfanin + n->nin, sizeof(int));
+			memcpy(r->fanins + r->nfanin, ids, n->nin * sizeof(int));
+			r->nfanin += n->nin;
+		}else if(tokenIs(token, len, ".latch") || tokenIs(token, len, ".subckt") || tokenIs(token, len, ".gate")){
+			printf("Error: %.*s is not supported, only combinational .names netlists\n", len, token);
+			free(ids);
+			return 0;
+		}
+		// .model, .end and other dot commands carry nothing we need
+	}
+	free(ids);
+	return buildGraph(r, 0);
+}
+
+//***********************************************************
+// binary AIGER
+static int readAigerNumber(cursor *c, unsigned int *value){
+	// 7-bit little endian varint of the AND gate deltas
+	unsigned int x = 0, shift = 0;
+	while(c->p < c->end){
+		unsigned char ch = *c->p++;
+		x |= (unsigned int)(ch & 0x7f) << shift;
+		if(!(ch & 0x80)){
+			*value = x;
+			return 1;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+static int readAigerDecimal(cursor *c, unsigned int *value){
+	// ASCII number of the header and output list, leading blanks skipped
+	while(c->p < c->end && (*c->p == ' ' || *c->p == '\t')) c->p++;
+	if(c->p == c->end || *c->p < '0' || *c->p > '9') return 0;
+	unsigned int x = 0;
+	while(c->p < c->end && *c->p >= '0' && *c->p <= '9') x = x * 10 + (*c->p++ - '0');
+	*value = x;
+	return 1;
+}
+
+static int readAigerNewline(cursor *c){
+	if(c->p < c->end && *c->p == '\r') c->p++;
+	if(c->p == c->end || *c->p != '\n') return 0;
+	c->p++;
+	return 1;
+}
+
+static int readAiger(reader *r, cursor *c){
+	unsigned int M, I, L, O, A;
+	if(c->end - c->p < 4 || memcmp(c->p, "aig ", 4) != 0){
+		printf("Error: bad AIGER header\n");
+		return 0;
+	}
+	c->p += 4;
+	if(!readAigerDecimal(c, &M) || !readAigerDecimal(c, &I) || !readAigerDecimal(c, &L) ||
+	   !readAigerDecimal(c, &O) || !readAigerDecimal(c, &A)){
+		printf("Error: bad AIGER header\n");
+		return 0;
+	}
+	while(c->p < c->end && *c->p != '\n') c->p++; // optional B C J F counts
+	if(c->p < c->end) c->p++;
+	if(L != 0){
+		printf("Error: AIGER latches are not supported\n");
+		return 0;
+	}
+	if((unsigned long long)I + A > M || M > INT_MAX / 2 - 1){
+		// the AND gates are variables I + 1 .. I + A, literals are ints
+		printf("Error: bad AIGER and gate\n");
+		return 0;
+	}
+	// net k is AIGER variable k, inputs are named by the symbol table below
+	int unnamed = addName(r, "", 0);
+	for(unsigned int k = 0; k <= M; k++) addNet(r, unnamed);
+	r->pis = malloc((I + 1) * sizeof(int));
+	r->pos = malloc((O + 1) * sizeof(int));
+	for(unsigned int k = 0; k < I; k++){
+		r->pis[r->npi++] = k + 1;
+	}
+	r->fanins = growArray(r->fanins, &r->capfanin, 2 * ((size_t)A + 1), sizeof(int));
+	unsigned int *po_lit = malloc((O + 1) * sizeof(unsigned int));
+	for(unsigned int k = 0; k < O; k++){
+		if(!readAigerDecimal(c, &po_lit[k]) || !readAigerNewline(c) || po_lit[k] > 2 * M + 1){
+			printf("Error: bad AIGER output list\n");
+			free(po_lit);
+			return 0;
+		}
+	}
+	for(unsigned int k = 0; k < A; k++){
+		unsigned int lhs = 2 * (I + k + 1), d0, d1;
+		if(!readAigerNumber(c, &d0) || !readAigerNumber(c, &d1)){
+			printf("Error: truncated AIGER file\n");
+			free(po_lit);
+			return 0;
+		}
+		if(d0 == 0 || d0 > lhs || d1 > lhs - d0){
+			// a gate reads smaller literals only
+			printf("Error: bad AIGER and gate\n");
+			free(po_lit);
+			return 0;
+		}
+		net *n = &r->nets[I + k + 1];
+		n->nin = 2;
+		n->fanin = r->nfanin;
+		r->fanins[r->nfanin++] = lhs - d0;
+		r->fanins[r->nfanin++] = lhs - d0 - d1;
+	}
+
+	// symbol table: "i<index> <name>" / "o<index> <name>", up to the comment section
+	int *po_names = malloc((O + 1) * sizeof(int));
+	memset(po_names, -1, (O + 1) * sizeof(int));
+	while(c->p < c->end && *c->p != 'c'){
+		char kind = *c->p++;
+		unsigned int index = 0;
+		int ok = readAigerDecimal(c, &index) && c->p < c->end && *c->p == ' ';
+		const char *sym = ok ? ++c->p : c->p;
+		while(c->p < c->end && *c->p != '\n' && *c->p != '\r') c->p++;
+		int len = c->p - sym;
+		while(c->p < c->end && *c->p != '\n') c->p++;
+		if(c->p < c->end) c->p++;
+		if(!ok || len == 0) continue;
+		if(kind == 'i' && index < I) r->nets[index + 1].name = addName(r, sym, len);
+		else if(kind == 'o' && index < O) po_names[index] = addName(r, sym, len);
+	}
+	char name[32];
+	for(unsigned int k = 0; k < I; k++){
+		if(r->nets[k + 1].name != unnamed) continue;
+		sprintf(name, "n%u", k + 1);
+		r->nets[k + 1].name = addName(r, name, strlen(name));
+	}
+	// outputs become extra nets driven by a buffer of their literal
+	for(unsigned int k = 0; k < O; k++){
+		if(po_names[k] < 0){
+			sprintf(name, "po%u", k);
+			po_names[k] = addName(r, name, strlen(name));
+		}
+		int id = addNet(r, po_names[k]);
+		net *n = &r->nets[id];
+		// AND with constant 1 folds to the driver literal in addAnd()
+		r->fanins = growArray(r->fanins, &r->capfanin, r->nfanin + 2, sizeof(int));
+		n->nin = 2;
+		n->fanin = r->nfanin;
+		r->fanins[r->nfanin++] = po_lit[k];
+		r->fanins[r->nfanin++] = LIT_CONST1;
+		r->pos[r->npo++] = id;
+	}
+	free(po_names);
+	free(po_lit);
+	// variable 0 is constant 0
+	r->nets[0].lit = LIT_CONST0;
+	r->nets[0].nin = 0;
+	return buildGraph(r, 1);
+}
+
+//***********************************************************
+// interface
+int readNetwork(timing_graph *g, const char *file_name, size_t *bytes){
+	// read a .blif or binary .aig file into g, its size goes to bytes, returns 0 on error
+	int fd = open(file_name, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0){
+		printf("Error: cannot open %s\n", file_name);
+		if(fd >= 0) close(fd);
+		return 0;
+	}
+	size_t size = st.st_size;
+	char *data = NULL;
+	int mapped = 0;
+	if(size > 0){
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		mapped = data != MAP_FAILED;
+		if(mapped){
+			madvise(data, size, MADV_SEQUENTIAL);
+		}else{
+			// not mappable (e.g. a pipe), fall back to one read into memory
+			data = malloc(size);
+			if(!data || read(fd, data, size) != (ssize_t)size){
+				printf("Error: cannot read %s\n", file_name);
+				free(data);
+				close(fd);
+				return 0;
+			}
+		}
+	}
+	close(fd);
+
+	reader r;
+	memset(&r, 0, sizeof(r));
+	r.g = g;
+	cursor c = {data, data + size};
+	int aiger = size >= 4 && memcmp(data, "aig ", 4) == 0;
+	int ok = aiger ? readAiger(&r, &c) : readBlif(&r, &c);
+	if(ok && r.npo == 0){
+		printf("Error: %s has no outputs\n", file_name);
+		ok = 0;
+	}
+	if(mapped) munmap(data, size);
+	else free(data);
+	readerFree(&r);
+	if(!ok) return 0;
+	*bytes = size;
+
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
+	return 1;
+}
@@ -0,0 +1,281 @@
+#include "ace.h"
+
+// Timing report (--report K): benchmark_name.timing holds a slack histogram of
+// the sized circuit's cells, the worst slack of every output and its K most
+// critical paths, stage by stage with the cells named as in the .mbench.
+// The paths come out of a best-first search from the outputs back to the
+// inputs: a partial path, the suffix from some node to an output, is keyed by
+// the slack of its worst completion, the required time it gives the node minus
+// the node's arrival. That key is exact, so the partial paths pop in slack
+// order, the first path reaching an input is the worst one, and K paths cost
+// about K times the depth heap operations however reconvergent the logic is
+// (c6288 has more paths than a double counts).
+
+#define REPORT_BINS 10	// slack histogram bins
+#define REPORT_BAR 50	// histogram bar of the fullest bin
+
+typedef struct path_entry{
+	int node;	// the first node of the suffix
+	int pin;	// the pin of the next node it drives, -1: the output itself
+	int next;	// entry of the next node, -1: none
+	double required;	// required time of node along the suffix
+} path_entry;
+
+typedef struct path_search{
+	timing_graph *g;
+	path_entry *entry;
+	int n, cap;
+	int *heap;	// entries by increasing slack
+	int heap_n, heap_cap;
+} path_search;
+
+static double pinInvDelay(timing_graph *g, int i, int pin){
+	// the inverter on pin of node i, 0 without one (same delays as the timing passes)
+	if(pin == 0) return COMPL0(g, i) ? nodeInvDelay(g, i, g->inv0_id[i]) : 0.0;
+	return COMPL1(g, i) ? invDelay(g->inv1_id[i]) : 0.0;
+}
+
+static double stageNand(timing_graph *g, int i){
+	return g->type[i] == GATE ? nandDelay(g, i, g->nand_id[i]) : 0.0;
+}
+
+static int pathStart(timing_graph *g, int i){
+	// paths begin at inputs and constants
+	return g->type[i] == PI || g->fanin0[i] < 0;
+}
+
+static double entrySlack(path_search *s, int e){
+	return s->entry[e].required - s->g->arrival[s->entry[e].node];
+}
+
+static void searchPush(path_search *s, int node, int pin, int next, double required){
+	if(s->n == s->cap){
+		s->cap = s->cap * 2 + 1024;
+		s->entry = realloc(s->entry, s->cap * sizeof(path_entry));
+	}
+	if(s->heap_n == s->heap_cap){
+		s->heap_cap = s->heap_cap * 2 + 1024;
+		s->heap = realloc(s->heap, s->heap_cap * sizeof(int));
+	}
+	if(!s->entry || !s->heap){
+		printf("Error: out of memory for the path search\n");
+		exit(1);
+	}
+	int e = s->n++;
+	s->entry[e] = (path_entry){node, pin, next, required};
+	double slack = entrySlack(s, e);
+	int k = s->heap_n++;
+	while(k > 0){
+		int parent = (k - 1) / 2;
+		if(entrySlack(s, s->heap[parent]) <= slack) break;
+		s->heap[k] = s->heap[parent];
+		k = parent;
+	}
+	s->heap[k] = e;
+}
+
+static int searchPop(path_search *s){
+	int top = s->heap[0];
+	int v = s->heap[--s->heap_n];
+	double slack = entrySlack(s, v);
+	int k = 0;
+	while(2*k + 1 < s->heap_n){
+		int child = 2*k + 1;
+		if(child + 1 < s->heap_n && entrySlack(s, s->heap[child + 1]) < entrySlack(s, s->heap[child])) child++;
+		if(slack <= entrySlack(s, s->heap[child])) break;
+		s->heap[k] = s->heap[child];
+		k = child;
+	}
+	s->heap[k] = v;
+	return top;
+}
+
+static int nextPath(path_search *s){
+	// entry of the next most critical path (its input), -1: no paths left
+	timing_graph *g = s->g;
+	while(s->heap_n > 0){
+		int e = searchPop(s);
+		int i = s->entry[e].node;
+		if(pathStart(g, i)) return e;
+		double required = s->entry[e].required - stageNand(g, i);
+		int pins = g->type[i] == GATE ? 2 : 1;
+		for(int pin = 0; pin < pins; pin++){
+			int fanin = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			searchPush(s, fanin, pin, e, required - pinInvDelay(g, i, pin));
+		}
+	}
+	return -1;
+}
+
+//***********************************************************
+// cell names
+typedef struct cell_ids{
+	// .mbench cell numbers X<id> of every node, 0: no cell
+	int *inv0;
+	int *inv1;
+	int *nand;	// a shared inverter's own cell
+} cell_ids;
+
+static void cellIds(timing_graph *g, cell_ids *c){
+	// numbered as Write() numbers them
+	c->inv0 = calloc(g->n, sizeof(int));
+	c->inv1 = calloc(g->n, sizeof(int));
+	c->nand = calloc(g->n, sizeof(int));
+	if(!c->inv0 || !c->inv1 || !c->nand){
+		printf("Error: out of memory for the timing report\n");
+		exit(1);
+	}
+	for(unsigned int i = 0, gid = 1; i < g->n; i++){
+		if(pathStart(g, i)) continue;
+		if(COMPL0(g, i)) c->inv0[i] = gid++;
+		if(g->type[i] == INVERTER) c->nand[i] = c->inv0[i];
+		if(g->type[i] != GATE) continue;
+		if(COMPL1(g, i)) c->inv1[i] = gid++;
+		c->nand[i] = gid++;
+	}
+}
+
+static void nodeText(timing_graph *g, const cell_ids *c, int i, char *buf, size_t size){
+	if(g->type[i] == PI || g->type[i] == PO) snprintf(buf, size, "%s (%s)", g->name[i], g->type[i] == PI ? "input" : "output");
+	else if(g->fanin0[i] < 0) snprintf(buf, size, "constant");
+	else snprintf(buf, size, "X%d", c->nand[i]);
+}
+
+static void writePath(FILE *file, timing_graph *g, const cell_ids *c, path_search *s, int e, int rank){
+	// stages from the input to the output, arrival accumulated as the timing passes add it
+	char text[256];
+	int end = e;
+	while(s->entry[end].next >= 0) end = s->entry[end].next;
+	double slack = entrySlack(s, e);
+	fprintf(file, "\npath %d: slack %.3f, required %.3f at %s\n", rank, FIX_NEG_ZERO(slack), s->entry[end].required,
+		g->name[s->entry[end].node]);
+	fprintf(file, "  %-24s %-12s %10s %10s\n", "point", "cell", "delay", "arrival");
+	nodeText(g, c, s->entry[e].node, text, sizeof(text));
+	double arrival = g->arrival[s->entry[e].node];
+	fprintf(file, "  %-24s %-12s %10.3f %10.3f\n", text, "", 0.0, arrival);
+	for(; s->entry[e].next >= 0; e = s->entry[e].next){
+		int i = s->entry[s->entry[e].next].node, pin = s->entry[e].pin;
+		int inv = pin == 0 ? c->inv0[i] : c->inv1[i];
+		if(inv){
+			double d = pinInvDelay(g, i, pin);
+			arrival += d;
+			snprintf(text, sizeof(text), "X%d", inv);
+			fprintf(file, "  %-24s %-12s %10.3f %10.3f\n", text, inverters[pin == 0 ? g->inv0_id[i] : g->inv1_id[i]].name,
+				d, arrival);
+		}
+		if(g->type[i] == GATE){
+			double d = stageNand(g, i);
+			arrival += d;
+			nodeText(g, c, i, text, sizeof(text));
+			fprintf(file, "  %-24s %-12s %10.3f %10.3f\n", text, nands[g->nand_id[i]].name, d, arrival);
+		}else if(g->type[i] == PO){
+			nodeText(g, c, i, text, sizeof(text));
+			fprintf(file, "  %-24s %-12s %10s %10.3f\n", text, "", "", arrival);
+		}
+	}
+}
+
+//***********************************************************
+// summaries
+static int slackCompare(const void *a, const void *b){
+	const double *x = a, *y = b;
+	return (x[0] > y[0]) - (x[0] < y[0]);
+}
+
+static void writeHistogram(FILE *file, timing_graph *g){
+	// slack of every cell output read by something: NANDs, shared inverters and outputs
+	double lo = DBL_MAX, hi = -DBL_MAX;
+	long nodes = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(pathStart(g, i) || g->required[i] == DBL_MAX) continue;
+		double slack = g->required[i] - g->arrival[i];
+		lo = min(lo, slack);
+		hi = max(hi, slack);
+		nodes++;
+	}
+	fprintf(file, "\nslack histogram: %ld nodes\n", nodes);
+	if(nodes == 0) return;
+	long count[REPORT_BINS] = {0}, most = 1;
+	double width = (hi - lo) / REPORT_BINS;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(pathStart(g, i) || g->required[i] == DBL_MAX) continue;
+		int bin = width > 0.0 ? (int)((g->required[i] - g->arrival[i] - lo) / width) : 0;
+		bin = min(max(bin, 0), REPORT_BINS - 1);
+		count[bin]++;
+		most = max(most, count[bin]);
+	}
+	for(int b = 0; b < REPORT_BINS; b++){
+		char bar[REPORT_BAR + 1];
+		int len = (int)((count[b] * REPORT_BAR + most - 1) / most);
+		memset(bar, '#', len);
+		bar[len] = '\0';
+		fprintf(file, "  [%10.3f, %10.3f%c %9ld %s\n", FIX_NEG_ZERO(lo + b * width), FIX_NEG_ZERO(lo + (b + 1) * width),
+			b == REPORT_BINS - 1 ? ']' : ')', count[b], bar);
+		if(width <= 0.0) break;
+	}
+}
+
+static void writeOutputs(FILE *file, timing_graph *g, double target){
+	// outputs by increasing slack
+	int n = 0;
+	for(unsigned int i = 0; i < g->n; i++) n += g->type[i] == PO && g->fanin0[i] >= 0;
+	double *slack = malloc(2 * (size_t)max(n, 1) * sizeof(double));	// (slack, node) pairs
+	n = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO || g->fanin0[i] < 0) continue;
+		slack[2*n] = PO_REQUIRED(g, i, target) - g->arrival[i];
+		slack[2*n + 1] = i;
+		n++;
+	}
+	qsort(slack, n, 2 * sizeof(double), slackCompare);
+	fprintf(file, "\nworst slack per output: %d outputs\n", n);
+	fprintf(file, "  %-24s %10s %10s %10s\n", "output", "required", "arrival", "slack");
+	for(int k = 0; k < n; k++){
+		int i = (int)slack[2*k + 1];
+		fprintf(file, "  %-24s %10.3f %10.3f %10.3f\n", g->name[i], PO_REQUIRED(g, i, target), g->arrival[i],
+			FIX_NEG_ZERO(slack[2*k]));
+	}
+	free(slack);
+}
+
+//***********************************************************
+int timingReport(const char *file_name, timing_graph *g, double target, int paths){
+	// after optimization(): the sized circuit timed afresh against target, returns 0 on an error
+	FILE *file = fopen(file_name, "w");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		return 0;
+	}
+	staFull(g, target);
+	double worst = DBL_MAX, delay = 0.0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO || g->fanin0[i] < 0) continue;
+		worst = min(worst, PO_REQUIRED(g, i, target) - g->arrival[i]);
+		delay = max(delay, g->arrival[i]);
+	}
+	fprintf(file, "Target : %.3f\nDelay : %.3f\nWorst slack : %.3f\n", target, delay,
+		FIX_NEG_ZERO(worst == DBL_MAX ? target : worst));
+	writeHistogram(file, g);
+	writeOutputs(file, g, target);
+
+	path_search s = {g};
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PO && g->fanin0[i] >= 0) searchPush(&s, i, -1, -1, PO_REQUIRED(g, i, target));
+	}
+	cell_ids c;
+	cellIds(g, &c);
+	fprintf(file, "\ncritical paths: %d worst\n", paths);
+	for(int rank = 1; rank <= paths; rank++){
+		int e = nextPath(&s);
+		if(e < 0) break;
+		writePath(file, g, &c, &s, e, rank);
+	}
+	free(c.inv0);
+	free(c.inv1);
+	free(c.nand);
+	free(s.entry);
+	free(s.heap);
+	int ok = fclose(file) == 0;
+	if(!ok) printf("Error: cannot write %s\n", file_name);
+	return ok;
+}
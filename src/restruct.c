@@ -0,0 +1,249 @@
+#include "ace.h"
+
+// Timing-driven AIG restructuring (--restructure). Before mapping() the graph
+// is an AIG: GATE nodes are ANDs and the compl bits are edge complements. The
+// AIG is timed as mapping() and initialDelay() will build it, with an inverter
+// on every edge whose complement disagrees with the NAND output phase and the
+// fastest cells. A supergate is a maximal tree of ANDs joined by plain edges
+// into single-fanout nodes; its k leaves can be regrouped freely into k-1 ANDs
+// without changing the inverters, the loads or the area. Supergates rooted in
+// the critical cones (slack within RESTRUCT_CONE of the worst delay) are rebuilt
+// in Huffman order on arrival, so late leaves enter the tree next to its root.
+// Rounds repeat while the worst delay drops, within a wall-clock budget.
+
+#define SUPERGATE_MAX 64	// leaves collected per supergate
+#define RESTRUCT_CONE 0.25	// critical cones: slack below this share of the worst delay
+
+typedef struct aig_timing{
+	double inv;	// fastest inverter at load 1
+	double *arrival;
+	double *required;
+} aig_timing;
+
+static double nandFast(int load){
+	return NAND_DELAY(load, libt.nand_fastest[load]);
+}
+
+static int edgeInverted(timing_graph *g, int fanin, int compl){
+	// mapping(): NAND outputs are inverted, PIs are not
+	return compl ^ (g->type[fanin] != PI);
+}
+
+static double pinArrival(timing_graph *g, aig_timing *t, int fanin, int compl){
+	return t->arrival[fanin] + (edgeInverted(g, fanin, compl) ? t->inv : 0.0);
+}
+
+static double aigTime(timing_graph *g, aig_timing *t){
+	// arrival and required times of the mapped AIG, returns the worst delay
+	double delay = 0.0;
+	for(unsigned int i = 0; i < g->n; i++){
+		t->required[i] = DBL_MAX;
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			t->arrival[i] = 0.0;
+			continue;
+		}
+		double a0 = pinArrival(g, t, g->fanin0[i], COMPL0(g, i));
+		if(g->type[i] == PO){
+			t->arrival[i] = a0;
+			delay = max(delay, a0);
+			continue;
+		}
+		double a1 = pinArrival(g, t, g->fanin1[i], COMPL1(g, i));
+		t->arrival[i] = max(a0, a1) + nandFast(FANOUT_NUM(g, i));
+	}
+	for(int i = g->n - 1; i >= 0; i--){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		if(g->type[i] == PO) t->required[i] = delay;
+		double base = t->required[i] - (g->type[i] == PO ? 0.0 : nandFast(FANOUT_NUM(g, i)));
+		int f0 = g->fanin0[i];
+		t->required[f0] = min(t->required[f0], base - (edgeInverted(g, f0, COMPL0(g, i)) ? t->inv : 0.0));
+		if(g->type[i] == PO) continue;
+		int f1 = g->fanin1[i];
+		t->required[f1] = min(t->required[f1], base - (edgeInverted(g, f1, COMPL1(g, i)) ? t->inv : 0.0));
+	}
+	return delay;
+}
+
+static int internalNode(timing_graph *g, int fanin, int compl){
+	// an AND read plainly by its only fanout belongs to the reader's supergate
+	return !compl && g->type[fanin] == GATE && FANOUT_NUM(g, fanin) == 1;
+}
+
+static int collectLeaves(timing_graph *g, int root, int *leaf, int *inner, int *ninner){
+	// leaves of root's supergate as literals 2*node + compl, its inner nodes; 0: too big
+	int stack[SUPERGATE_MAX], n = 0, sp = 0;
+	stack[sp++] = root;
+	*ninner = 0;
+	while(sp > 0){
+		int i = stack[--sp];
+		if(i != root) inner[(*ninner)++] = i;
+		for(int pin = 0; pin < 2; pin++){
+			int f = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			int c = pin == 0 ? COMPL0(g, i) : COMPL1(g, i);
+			if(n + sp + 1 >= SUPERGATE_MAX) return 0;
+			if(internalNode(g, f, c)) stack[sp++] = f;
+			else leaf[n++] = 2 * f + c;
+		}
+	}
+	// a repeated leaf would make the regrouped tree redundant, leave such trees alone
+	for(int a = 0; a < n; a++){
+		for(int b = a + 1; b < n; b++) if(leaf[a] >> 1 == leaf[b] >> 1) return 0;
+	}
+	return n;
+}
+
+static int innerNode(timing_graph *g, int i){
+	// i is an inner node of its fanout's supergate
+	if(FANOUT_NUM(g, i) != 1) return 0;
+	int fo = g->fanout[g->fanout_start[i]];
+	return g->type[fo] == GATE && internalNode(g, i, g->fanin0[fo] == i ? COMPL0(g, fo) : COMPL1(g, fo));
+}
+
+typedef struct restruct_state{
+	timing_graph *g;
+	aig_timing t;
+	char *role;	// 1: rebuilt supergate root, 2: inner node dropped by a rebuild
+	int *tree;	// per rebuilt root: the AND count, then the ANDs as (ref0, ref1), the root last
+	int *tree_start;	// root -> offset in tree
+	int tree_n, tree_cap;
+} restruct_state;
+
+// refs in tree: >= 0 a leaf literal 2*node + compl, < 0 the -(k+1)th AND of the same tree
+
+static int balanceSupergate(restruct_state *s, int root){
+	// rebuild root's supergate if that makes its output earlier, returns 1 when rebuilt
+	timing_graph *g = s->g;
+	int leaf[SUPERGATE_MAX], inner[SUPERGATE_MAX], ninner;
+	int n = collectLeaves(g, root, leaf, inner, &ninner);
+	if(n < 3) return 0;
+
+	int ref[SUPERGATE_MAX];
+	double at[SUPERGATE_MAX];	// arrival at the input of the AND reading the entry
+	for(int k = 0; k < n; k++){
+		ref[k] = leaf[k];
+		at[k] = pinArrival(g, &s->t, leaf[k] >> 1, leaf[k] & 1);
+	}
+	if(s->tree_n + 2 * n > s->tree_cap){
+		s->tree_cap = s->tree_cap * 2 + 2 * SUPERGATE_MAX;
+		s->tree = realloc(s->tree, s->tree_cap * sizeof(int));
+	}
+	int start = s->tree_n;
+	s->tree[s->tree_n++] = n - 1;
+	double out = 0.0;
+	for(int m = n, ands = 1; m > 1; m--, ands++){
+		// the two earliest entries form the next AND
+		for(int pass = 0; pass < 2; pass++){
+			int best = pass;
+			for(int k = pass + 1; k < m; k++) if(at[k] < at[best]) best = k;
+			int r = ref[pass]; ref[pass] = ref[best]; ref[best] = r;
+			double a = at[pass]; at[pass] = at[best]; at[best] = a;
+		}
+		s->tree[s->tree_n++] = ref[0];
+		s->tree[s->tree_n++] = ref[1];
+		out = max(at[0], at[1]) + nandFast(m == 2 ? FANOUT_NUM(g, root) : 1);
+		// the new AND takes the first entry, read plainly and so through an inverter
+		ref[0] = -ands;
+		at[0] = out + s->t.inv;
+		ref[1] = ref[m - 1];
+		at[1] = at[m - 1];
+	}
+	if(out >= s->t.arrival[root] - 1e-9){
+		s->tree_n = start;
+		return 0;
+	}
+	s->role[root] = 1;
+	s->tree_start[root] = start;
+	for(int k = 0; k < ninner; k++) s->role[inner[k]] = 2;
+	s->t.arrival[root] = out;
+	return 1;
+}
+
+static void rebuildGraph(restruct_state *s){
+	// rebuilt supergates take their root's place, their inner nodes are dropped
+	timing_graph *g = s->g;
+	timing_graph h;
+	memset(&h, 0, sizeof(h));
+	graphReserve(&h, g->n);
+	int *map = malloc(g->n * sizeof(int));
+	int made[SUPERGATE_MAX];
+	for(unsigned int i = 0; i < g->n; i++){
+		if(s->role[i] == 2) continue;
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			map[i] = graphAddNode(&h, g->type[i], -1, -1, g->compl[i], g->name[i]);
+		}else if(s->role[i] == 1){
+			const int *tree = s->tree + s->tree_start[i];
+			for(int k = 0; k < tree[0]; k++){
+				int fanin[2], compl = 0;
+				for(int pin = 0; pin < 2; pin++){
+					int r = tree[1 + 2 * k + pin];
+					fanin[pin] = r >= 0 ? map[r >> 1] : made[-r - 1];
+					if(r >= 0) compl |= (r & 1) << pin;
+				}
+				made[k] = graphAddNode(&h, GATE, fanin[0], fanin[1], compl, NULL);
+			}
+			map[i] = made[tree[0] - 1];
+		}else{
+			int fanin1 = g->type[i] == PO ? -1 : map[g->fanin1[i]];
+			map[i] = graphAddNode(&h, g->type[i], map[g->fanin0[i]], fanin1, g->compl[i], g->name[i]);
+		}
+		g->name[i] = NULL;
+	}
+	free(map);
+	graphFree(g);
+	*g = h;
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
+}
+
+double restructure(timing_graph *g, double budget, int verbose){
+	// before mapping(), the library held by libUse(): returns the worst delay of the input structure
+	if(inv_count == 0 || nand_count == 0) return 0.0;
+	double t0 = wallTime();
+	restruct_state s = {g};
+	s.t.inv = invDelay(libt.inv_fastest[1]);
+	double first = 0.0, last = DBL_MAX;
+	for(int round = 0; ; round++){
+		s.t.arrival = malloc(g->n * sizeof(double));
+		s.t.required = malloc(g->n * sizeof(double));
+		s.role = calloc(g->n, 1);
+		s.tree_start = malloc(g->n * sizeof(int));
+		if(!s.t.arrival || !s.t.required || !s.role || !s.tree_start){
+			printf("Error: out of memory for restructuring\n");
+			exit(1);
+		}
+		double now = aigTime(g, &s.t);
+		if(round == 0) first = now;
+		int rebuilt = 0;
+		if(now < last - 1e-9 && wallTime() - t0 < budget){
+			// supergates in topological order, arrivals follow the rebuilds made so far
+			double cone = RESTRUCT_CONE * now;
+			for(unsigned int i = 0; i < g->n; i++){
+				if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+				if(g->type[i] == GATE && s.role[i] == 0 && s.t.required[i] - s.t.arrival[i] < cone && !innerNode(g, i)){
+					if(balanceSupergate(&s, i)){
+						rebuilt++;
+						continue;
+					}
+				}
+				double a0 = pinArrival(g, &s.t, g->fanin0[i], COMPL0(g, i));
+				if(g->type[i] == PO) s.t.arrival[i] = a0;
+				else s.t.arrival[i] = max(a0, pinArrival(g, &s.t, g->fanin1[i], COMPL1(g, i))) + nandFast(FANOUT_NUM(g, i));
+			}
+			if(verbose) printf("restructure: round %d delay %.3f, %d supergates rebuilt\n", round + 1, now, rebuilt);
+		}
+		last = min(last, now);
+		if(rebuilt > 0){
+			rebuildGraph(&s);
+			PROF_COUNT(PROF_NODES, g->n);
+		}
+		free(s.t.arrival);
+		free(s.t.required);
+		free(s.role);
+		free(s.tree_start);
+		s.tree_n = 0;
+		if(rebuilt == 0) break;
+	}
+	free(s.tree);
+	if(verbose) printf("restructure: delay %.3f -> %.3f in %.4f s\n", first, last, wallTime() - t0);
+	return first;
+}
@@ -0,0 +1,647 @@
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ace.h"
+
+// Resident sizing server (--serve SOCKET). The parsed library and one sized
+// design stay in memory and a client edits the design over a Unix domain
+// socket, one command per line and one reply line per command ("ok ..." or
+// "error ..."); clients are served one after the other:
+//   load FILE [T|Fx]            read, map and size FILE (greedy), against T
+//   worst                       delay, worst slack and area of the design
+//   slack NODE                  arrival, required time and slack of NODE
+//   swap NODE nand|inv0|inv1 CELL   put library cell CELL in one slot of NODE
+//   insert SINK PIN [!]A [!]B   a new NAND of A and B drives pin PIN of SINK
+//   remove NODE                 readers of NODE read the signal on its pin 0
+//   size NODE [DEPTH]           greedy re-size of NODE and its fanin cone
+//   write [FILE]                the .mbench, next to the design by default
+//   quit / shutdown             close the connection / stop the server
+// NODE is #<index> in the graph or a port name (the output on a tie). An edit
+// marks the nodes whose fanins, cells or loads it changed and the incremental
+// timer (staUpdate()) re-times from there, stopping where the change is
+// absorbed, so a swap costs its timing cone, not the design. Gates an edit
+// leaves without readers are dropped with the logic only they read. Inserting
+// or removing nodes also moves the arrays above them to keep the topological
+// order and rebuilds the fanout and level lists, linear but cheap passes. The
+// replies of edits carry the nodes re-timed and the time taken.
+
+#define SERVE_LINE 4096	// longest command line
+#define SERVE_ARGS 8
+#define SERVE_DEPTH 3	// size: fanin levels re-sized by default
+
+typedef struct serve_state{
+	timing_graph g;
+	char *design;	// the loaded circuit, NULL: none
+	double target;	// required time of the outputs
+	double area;	// cells of the current netlist
+	const timing_constraints *constraints;
+	int slack_on;
+	int *po;	// the outputs
+	int npo;
+	int *stamp;	// size: nodes of the region are stamped epoch
+	unsigned int stamp_cap;
+	int epoch;
+} serve_state;
+
+static void listOutputs(serve_state *s){
+	// after a load or an edit that moved nodes
+	timing_graph *g = &s->g;
+	s->po = realloc(s->po, max(g->n, 1) * sizeof(int));
+	s->npo = 0;
+	for(unsigned int i = 0; i < g->n; i++) if(g->type[i] == PO && g->fanin0[i] >= 0) s->po[s->npo++] = i;
+}
+
+static void designFree(serve_state *s){
+	if(!s->design) return;
+	graphFree(&s->g);
+	libDone();
+	free(s->design);
+	s->design = NULL;
+}
+
+static int nodeRef(serve_state *s, const char *text){
+	// #<index> or a port name, -1: no such node
+	timing_graph *g = &s->g;
+	if(text[0] == '#'){
+		char *end;
+		long i = strtol(text + 1, &end, 10);
+		return end != text + 1 && *end == '\0' && i >= 0 && i < (long)g->n ? (int)i : -1;
+	}
+	for(int i = g->n - 1; i >= 0; i--){
+		if(g->name[i] && strcmp(g->name[i], text) == 0) return i;
+	}
+	return -1;
+}
+
+static int summary(serve_state *s, int node, int retimed, char *reply, size_t size){
+	// the reply of an edit
+	timing_graph *g = &s->g;
+	double worst = DBL_MAX, delay = 0.0;
+	for(int k = 0; k < s->npo; k++){
+		int i = s->po[k];
+		worst = min(worst, g->required[i] - g->arrival[i]);
+		delay = max(delay, g->arrival[i]);
+	}
+	if(worst == DBL_MAX) worst = s->target;
+	int len = node >= 0 ? snprintf(reply, size, "node=#%d ", node) : 0;
+	snprintf(reply + len, size - len, "delay=%.3f worst_slack=%.3f area=%.3f nodes=%u retimed=%d", delay,
+		FIX_NEG_ZERO(worst), s->area, g->n, retimed);
+	return 1;
+}
+
+//***********************************************************
+// edits
+static void libLoads(timing_graph *g, const int *node, int n){
+	// the delay tables must cover the loads an edit raised
+	int load = 0;
+	for(int k = 0; k < n; k++) if(node[k] >= 0) load = max(load, FANOUT_NUM(g, node[k]));
+	if(load <= libt.max_load) return;
+	libDone();
+	libUse(load);
+}
+
+static void touch(timing_graph *g, const int *node, int n){
+	for(int k = 0; k < n; k++) if(node[k] >= 0) staTouch(g, node[k]);
+}
+
+#define SHIFT(a, to, from, n) memmove((a) + (to), (a) + (from), (n) * sizeof(*(a)))
+
+static void shiftNodes(timing_graph *g, int to, int from, int n){
+	// move nodes from .. from+n-1 to to .. to+n-1
+	SHIFT(g->type, to, from, n);
+	SHIFT(g->compl, to, from, n);
+	SHIFT(g->fanin0, to, from, n);
+	SHIFT(g->fanin1, to, from, n);
+	SHIFT(g->arrival, to, from, n);
+	SHIFT(g->required, to, from, n);
+	SHIFT(g->slack, to, from, n);
+	SHIFT(g->inv_slack0, to, from, n);
+	SHIFT(g->inv_slack1, to, from, n);
+	SHIFT(g->nand_id, to, from, n);
+	SHIFT(g->inv0_id, to, from, n);
+	SHIFT(g->inv1_id, to, from, n);
+	SHIFT(g->name, to, from, n);
+	if(g->port_time) SHIFT(g->port_time, to, from, n);
+}
+
+static void graphOpen(timing_graph *g, int pos){
+	// an empty GATE at index pos, the nodes from pos on move up by one
+	graphReserve(g, g->n + 1);
+	if(g->port_time){
+		g->port_time = realloc(g->port_time, (g->n + 1) * sizeof(double));
+		if(!g->port_time){
+			printf("Error: out of memory for port times\n");
+			exit(1);
+		}
+	}
+	shiftNodes(g, pos + 1, pos, g->n - pos);
+	g->n++;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->fanin0[i] >= pos) g->fanin0[i]++;
+		if(g->fanin1[i] >= pos) g->fanin1[i]++;
+	}
+	g->type[pos] = GATE;
+	g->compl[pos] = 0;
+	g->fanin0[pos] = g->fanin1[pos] = -1;
+	g->arrival[pos] = 0.0;
+	g->required[pos] = DBL_MAX;
+	g->slack[pos] = g->inv_slack0[pos] = g->inv_slack1[pos] = 0.0;
+	g->nand_id[pos] = g->inv0_id[pos] = g->inv1_id[pos] = -1;
+	g->name[pos] = NULL;
+	if(g->port_time) g->port_time[pos] = 0.0;
+}
+
+static int *sweepUnread(serve_state *s, int root, int **lost, int *nlost){
+	// drop root, a gate nothing reads, and the gates only it read, fanouts built; returns the
+	// old -> new index map (-1: dropped), lost gets the nodes kept that lost readers (new indices)
+	timing_graph *g = &s->g;
+	unsigned int n = g->n;
+	int *map = malloc(n * sizeof(int));	// readers left until the map is built
+	int *stack = malloc(n * sizeof(int)), top = 0;
+	*lost = malloc(2 * n * sizeof(int));
+	*nlost = 0;
+	if(!map || !stack || !*lost){
+		printf("Error: out of memory for the edit\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < n; i++) map[i] = FANOUT_NUM(g, i);
+	map[root] = -1;
+	stack[top++] = root;
+	while(top > 0){
+		int d = stack[--top];
+		s->area -= nodeArea(g, d);
+		for(int pin = 0; pin < (g->type[d] == GATE ? 2 : 1); pin++){
+			int f = pin == 0 ? g->fanin0[d] : g->fanin1[d];
+			if(f < 0 || map[f] < 0) continue;
+			if(--map[f] > 0 || g->type[f] == PI){
+				(*lost)[(*nlost)++] = f;
+				continue;
+			}
+			map[f] = -1;
+			stack[top++] = f;
+		}
+	}
+	// the runs of nodes kept move down in one piece each
+	unsigned int k = 0;
+	for(unsigned int i = 0; i < n; ){
+		if(map[i] < 0){
+			free(g->name[i++]);
+			continue;
+		}
+		unsigned int run = i;
+		while(i < n && map[i] >= 0) map[i++] = k++;
+		if(k - (i - run) != run) shiftNodes(g, k - (i - run), run, i - run);
+	}
+	g->n = k;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->fanin0[i] >= 0) g->fanin0[i] = map[g->fanin0[i]];
+		if(g->fanin1[i] >= 0) g->fanin1[i] = map[g->fanin1[i]];
+	}
+	for(int j = 0; j < *nlost; j++) (*lost)[j] = map[(*lost)[j]];
+	free(stack);
+	return map;
+}
+
+static int swapCell(serve_state *s, int node, int pin, int cell){
+	// one cell of node, re-timed; returns the nodes re-timed
+	timing_graph *g = &s->g;
+	int now = pin == STA_NAND ? g->nand_id[node] : pin == STA_INV0 ? g->inv0_id[node] : g->inv1_id[node];
+	if(cell < 0 || cell == now) return 0;
+	s->area -= nodeArea(g, node);
+	staResize(g, node, pin, cell);
+	s->area += nodeArea(g, node);
+	return staUpdate(g);
+}
+
+static int resizeNode(serve_state *s, int i){
+	// the smallest cells of node i that fit its slack as the times are now, the fastest
+	// where there is none; every swap is re-timed before the next one is picked
+	timing_graph *g = &s->g;
+	int retimed = 0;
+	if(g->type[i] == PI || g->fanin0[i] < 0) return 0;
+	if(g->type[i] == GATE){
+		int load = FANOUT_NUM(g, i);
+		double a0 = g->arrival[g->fanin0[i]] + (COMPL0(g, i) ? invDelay(g->inv0_id[i]) : 0.0);
+		double a1 = g->arrival[g->fanin1[i]] + (COMPL1(g, i) ? invDelay(g->inv1_id[i]) : 0.0);
+		double budget = g->required[i] - max(a0, a1);
+		int j = budget > 0 ? smallestNand(load, budget) : -1;
+		retimed += swapCell(s, i, STA_NAND, j >= 0 ? j : libt.nand_fastest[load]);
+	}
+	for(int pin = 0; pin < 2; pin++){
+		if(!(pin == 0 ? COMPL0(g, i) : g->type[i] == GATE && COMPL1(g, i))) continue;
+		int load = pin == 0 ? INV_LOAD(g, i) : 1;
+		double nand = g->type[i] == GATE ? nandDelay(g, i, g->nand_id[i]) : 0.0;
+		double budget = g->required[i] - nand - g->arrival[pin == 0 ? g->fanin0[i] : g->fanin1[i]];
+		int j = budget > 0 ? smallestInv(load, budget) : -1;
+		retimed += swapCell(s, i, pin == 0 ? STA_INV0 : STA_INV1, j >= 0 ? j : libt.inv_fastest[load]);
+	}
+	return retimed;
+}
+
+static int intCompare(const void *a, const void *b){
+	return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+//***********************************************************
+// commands
+static int cmdLoad(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph g;
+	memset(&g, 0, sizeof(g));
+	timing_constraints local;
+	const timing_constraints *c = s->constraints;
+	if(nargs > 2){
+		// the design's own target on top of the shared constraints
+		if(c) local = *c;
+		else defaultConstraints(&local);
+		if(!parseTarget(arg[2], &local.target, &local.relative)){
+			snprintf(reply, size, "bad target %s (a time or Fx)", arg[2]);
+			if(!c) freeConstraints(&local);
+			return 0;
+		}
+	}
+	size_t bytes;
+	// a file that can't be read leaves the loaded design as it is
+	if(!readNetwork(&g, arg[1], &bytes)){
+		graphFree(&g);
+		snprintf(reply, size, "cannot read %s", arg[1]);
+		if(nargs > 2 && !c) freeConstraints(&local);
+		return 0;
+	}
+	designFree(s);
+	s->g = g;
+	s->design = strdup(arg[1]);
+	timing_graph *h = &s->g;
+	// the flow of a run without options, sized by the greedy pass
+	libUse(max(graphMaxFanout(h), 2));
+	mapping(h);
+	if(c) constrainPorts(h, c);
+	initialDelay(h);
+	double target = h->initial_delay;
+	if(nargs > 2) target = constraintTarget(&local, target);
+	else if(c) target = constraintTarget(c, target);
+	if(target != h->initial_delay || h->port_time){
+		h->initial_delay = target;
+		relaxRequired(h, target);
+		staBackward(h, target);
+	}
+	optimization(h);
+	staFull(h, target);
+	s->target = target;
+	listOutputs(s);
+	s->area = 0.0;
+	for(unsigned int i = 0; i < h->n; i++) s->area += nodeArea(h, i);
+	if(nargs > 2 && !c) freeConstraints(&local);
+	return summary(s, -1, h->n, reply, size);
+}
+
+static int cmdWorst(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	return summary(s, -1, 0, reply, size);
+}
+
+static int cmdSlack(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	int i = nodeRef(s, arg[1]);
+	if(i < 0){
+		snprintf(reply, size, "no node %s", arg[1]);
+		return 0;
+	}
+	if(g->required[i] == DBL_MAX){
+		// nothing reads it
+		snprintf(reply, size, "node=#%d arrival=%.3f required=none slack=none", i, g->arrival[i]);
+		return 1;
+	}
+	snprintf(reply, size, "node=#%d arrival=%.3f required=%.3f slack=%.3f", i, g->arrival[i], g->required[i],
+		FIX_NEG_ZERO(g->required[i] - g->arrival[i]));
+	return 1;
+}
+
+static int cmdSwap(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	int i = nodeRef(s, arg[1]);
+	if(i < 0){
+		snprintf(reply, size, "no node %s", arg[1]);
+		return 0;
+	}
+	int pin = strcmp(arg[2], "nand") == 0 ? STA_NAND : strcmp(arg[2], "inv0") == 0 ? STA_INV0 :
+		strcmp(arg[2], "inv1") == 0 ? STA_INV1 : -1;
+	int slot = pin == STA_NAND ? g->type[i] == GATE : pin == STA_INV0 ? g->type[i] != PI && g->fanin0[i] >= 0 && COMPL0(g, i) :
+		pin == STA_INV1 && g->type[i] == GATE && COMPL1(g, i);
+	if(!slot){
+		snprintf(reply, size, "#%d has no %s cell", i, arg[2]);
+		return 0;
+	}
+	int cell = -1;
+	unsigned int count = pin == STA_NAND ? nand_count : inv_count;
+	for(unsigned int k = 0; k < count; k++){
+		if(strcmp((pin == STA_NAND ? nands : inverters)[k].name, arg[3]) == 0) cell = k;
+	}
+	if(cell < 0){
+		snprintf(reply, size, "no %s cell %s", pin == STA_NAND ? "NAND" : "inverter", arg[3]);
+		return 0;
+	}
+	return summary(s, i, swapCell(s, i, pin, cell), reply, size);
+}
+
+static int cmdInsert(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	int sink = nodeRef(s, arg[1]);
+	int pin = strcmp(arg[2], "0") == 0 ? 0 : strcmp(arg[2], "1") == 0 ? 1 : -1;
+	if(sink < 0 || g->type[sink] == PI || g->fanin0[sink] < 0 || pin < 0 || (pin == 1 && g->type[sink] != GATE)){
+		snprintf(reply, size, "no pin %s of %s", arg[2], arg[1]);
+		return 0;
+	}
+	int in[2], inverted[2];
+	for(int k = 0; k < 2; k++){
+		const char *text = arg[3 + k];
+		inverted[k] = text[0] == '!';
+		in[k] = nodeRef(s, text + inverted[k]);
+		// the new node goes right before its sink, so its fanins must come before the sink
+		if(in[k] < 0 || in[k] >= sink || g->type[in[k]] == PO){
+			snprintf(reply, size, "%s can't drive a node before %s", text, arg[1]);
+			return 0;
+		}
+	}
+	int old = pin == 0 ? g->fanin0[sink] : g->fanin1[sink];
+	int x = sink++;
+	graphOpen(g, x);
+	g->compl[x] = inverted[0] | inverted[1] << 1;
+	g->fanin0[x] = in[0];
+	g->fanin1[x] = in[1];
+	if(pin == 0) g->fanin0[sink] = x;
+	else g->fanin1[sink] = x;
+	graphBuildFanouts(g);
+	int *lost = NULL, nlost = 0;
+	if(FANOUT_NUM(g, old) == 0 && g->type[old] != PI){
+		// the logic the new gate replaced goes with it
+		int *map = sweepUnread(s, old, &lost, &nlost);
+		x = map[x];
+		sink = map[sink];
+		in[0] = map[in[0]];
+		in[1] = map[in[1]];
+		old = -1;
+		free(map);
+		graphBuildFanouts(g);
+	}
+	graphBuildLevels(g);
+	listOutputs(s);
+	int changed[] = {x, sink, in[0], in[1], old};
+	libLoads(g, changed, 5);
+	// the fastest cells, size makes them fit the slack
+	g->nand_id[x] = libt.nand_fastest[FANOUT_NUM(g, x)];
+	if(inverted[0]) g->inv0_id[x] = libt.inv_fastest[1];
+	if(inverted[1]) g->inv1_id[x] = libt.inv_fastest[1];
+	s->area += nodeArea(g, x);
+	touch(g, changed, 5);
+	touch(g, lost, nlost);
+	free(lost);
+	return summary(s, x, staUpdate(g), reply, size);
+}
+
+static int cmdRemove(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	int v = nodeRef(s, arg[1]);
+	if(v < 0 || (g->type[v] != GATE && g->type[v] != INVERTER)){
+		snprintf(reply, size, "%s is not a gate", arg[1]);
+		return 0;
+	}
+	// readers take the signal on pin 0, the gate's input inverter moves onto them
+	int driver = g->fanin0[v], flip = COMPL0(g, v);
+	int nreaders = FANOUT_NUM(g, v);
+	int *reader = malloc((nreaders + 1) * sizeof(int));
+	memcpy(reader, g->fanout + g->fanout_start[v], nreaders * sizeof(int));
+	for(int k = 0; k < nreaders; k++){
+		int r = reader[k];
+		if(flip && g->type[r] == INVERTER){
+			snprintf(reply, size, "#%d reads %s as a shared inverter, remove #%d first", r, arg[1], r);
+			free(reader);
+			return 0;
+		}
+	}
+	for(int k = 0; k < nreaders; k++){
+		int r = reader[k];
+		if(k > 0 && r == reader[k - 1]) continue;	// read on both pins
+		s->area -= nodeArea(g, r);
+		if(g->fanin0[r] == v){
+			g->fanin0[r] = driver;
+			g->compl[r] ^= flip;
+		}
+		if(g->fanin1[r] == v){
+			g->fanin1[r] = driver;
+			g->compl[r] ^= flip << 1;
+		}
+	}
+	graphBuildFanouts(g);
+	// v goes, and with it the logic only v read
+	int *lost, nlost;
+	int *map = sweepUnread(s, v, &lost, &nlost);
+	for(int k = 0; k < nreaders; k++) reader[k] = map[reader[k]];
+	reader[nreaders] = driver = map[driver];
+	free(map);
+	graphBuildFanouts(g);
+	graphBuildLevels(g);
+	listOutputs(s);
+	libLoads(g, reader, nreaders + 1);
+	for(int k = 0; k < nreaders; k++){
+		int r = reader[k];
+		if(k > 0 && r == reader[k - 1]) continue;
+		// an inverter the move added gets the fastest cell, one it cancelled goes
+		if(!COMPL0(g, r)) g->inv0_id[r] = -1;
+		else if(g->inv0_id[r] < 0) g->inv0_id[r] = libt.inv_fastest[INV_LOAD(g, r)];
+		if(!COMPL1(g, r) || g->type[r] != GATE) g->inv1_id[r] = -1;
+		else if(g->inv1_id[r] < 0) g->inv1_id[r] = libt.inv_fastest[1];
+		s->area += nodeArea(g, r);
+	}
+	touch(g, reader, nreaders + 1);
+	touch(g, lost, nlost);
+	free(lost);
+	free(reader);
+	return summary(s, driver, staUpdate(g), reply, size);
+}
+
+static int cmdSize(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	int root = nodeRef(s, arg[1]);
+	int depth = nargs > 2 ? atoi(arg[2]) : SERVE_DEPTH;
+	if(root < 0 || depth < 0){
+		snprintf(reply, size, root < 0 ? "no node %s" : "bad depth %s", root < 0 ? arg[1] : arg[2]);
+		return 0;
+	}
+	if(s->stamp_cap < g->cap){
+		s->stamp = realloc(s->stamp, g->cap * sizeof(int));
+		memset(s->stamp + s->stamp_cap, 0, (g->cap - s->stamp_cap) * sizeof(int));
+		s->stamp_cap = g->cap;
+	}
+	// the region: root and its fanins depth levels up, breadth first, then in topological order
+	int *region = malloc(g->n * sizeof(int)), *level = malloc(g->n * sizeof(int));
+	int n = 0;
+	s->epoch++;
+	region[n] = root;
+	level[n++] = 0;
+	s->stamp[root] = s->epoch;
+	for(int k = 0; k < n; k++){
+		int i = region[k];
+		if(level[k] == depth || g->type[i] == PI || g->fanin0[i] < 0) continue;
+		for(int pin = 0; pin < (g->type[i] == GATE ? 2 : 1); pin++){
+			int fanin = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			if(s->stamp[fanin] == s->epoch) continue;
+			s->stamp[fanin] = s->epoch;
+			region[n] = fanin;
+			level[n++] = level[k] + 1;
+		}
+	}
+	qsort(region, n, sizeof(int), intCompare);
+	int retimed = 0;
+	for(int k = 0; k < n; k++) retimed += resizeNode(s, region[k]);
+	free(region);
+	free(level);
+	return summary(s, root, retimed, reply, size);
+}
+
+static int cmdWrite(serve_state *s, char **arg, int nargs, char *reply, size_t size){
+	timing_graph *g = &s->g;
+	char *file_name = nargs > 1 ? strdup(arg[1]) : outputName(s->design, ".mbench");
+	FILE *file = fopen(file_name, "a");
+	if(!file){
+		snprintf(reply, size, "cannot open %s", file_name);
+		free(file_name);
+		return 0;
+	}
+	fclose(file);
+	g->optimized_area = s->area;
+	staSlacks(g);
+	int ok = Write(file_name, g, s->slack_on);
+	if(ok) snprintf(reply, size, "file=%s area=%.3f", file_name, s->area);
+	else snprintf(reply, size, "cannot write %s", file_name);
+	free(file_name);
+	return ok;
+}
+
+typedef struct serve_command{
+	const char *name;
+	int args;	// arguments it needs
+	int more;	// optional arguments after them
+	int (*run)(serve_state *s, char **arg, int nargs, char *reply, size_t size);
+} serve_command;
+
+static const serve_command commands[] = {
+	{"load", 1, 1, cmdLoad},
+	{"worst", 0, 0, cmdWorst},
+	{"slack", 1, 0, cmdSlack},
+	{"swap", 3, 0, cmdSwap},
+	{"insert", 4, 0, cmdInsert},
+	{"remove", 1, 0, cmdRemove},
+	{"size", 1, 1, cmdSize},
+	{"write", 0, 1, cmdWrite},
+};
+#define COMMANDS ((int)(sizeof(commands) / sizeof(commands[0])))
+
+//***********************************************************
+// connections
+static int serveClient(serve_state *s, int fd){
+	// commands of one client until it quits or hangs up, returns 1 on shutdown
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+	if(!in || !out){
+		printf("Error: cannot open the connection\n");
+		if(in) fclose(in);
+		else close(fd);
+		if(out) fclose(out);
+		return 0;
+	}
+	char line[SERVE_LINE], reply[SERVE_LINE];
+	int stop = 0;
+	while(fgets(line, sizeof(line), in)){
+		if(!strchr(line, '\n') && !feof(in)){
+			// the rest of an overlong line is dropped, it gets one reply like any other
+			int ch;
+			while((ch = getc(in)) != EOF && ch != '\n');
+			fprintf(out, "error line longer than %d bytes\n", SERVE_LINE - 2);
+			fflush(out);
+			continue;
+		}
+		char *arg[SERVE_ARGS + 1], *save;
+		int nargs = 0;
+		for(char *t = strtok_r(line, " \t\r\n", &save); t; t = strtok_r(NULL, " \t\r\n", &save)){
+			if(nargs <= SERVE_ARGS) arg[nargs] = t;
+			nargs++;
+		}
+		if(nargs == 0 || arg[0][0] == '#') continue;
+		if(strcmp(arg[0], "quit") == 0 || strcmp(arg[0], "shutdown") == 0){
+			stop = arg[0][0] == 's';
+			fprintf(out, "ok bye\n");
+			break;
+		}
+		const serve_command *c = NULL;
+		for(int k = 0; k < COMMANDS; k++) if(strcmp(arg[0], commands[k].name) == 0) c = &commands[k];
+		double t0 = wallTime();
+		if(!c) fprintf(out, "error unknown command %s\n", arg[0]);
+		else if(nargs - 1 < c->args || nargs - 1 > c->args + c->more){
+			if(c->more) fprintf(out, "error %s takes %d to %d arguments\n", c->name, c->args, c->args + c->more);
+			else fprintf(out, "error %s takes %d arguments\n", c->name, c->args);
+		}
+		else if(!s->design && c->run != cmdLoad) fprintf(out, "error no design loaded\n");
+		else if(!c->run(s, arg, nargs, reply, sizeof(reply))) fprintf(out, "error %s\n", reply);
+		else fprintf(out, "ok %s us=%.1f\n", reply, (wallTime() - t0) * 1e6);
+		fflush(out);
+	}
+	fflush(out);
+	fclose(out);
+	fclose(in);
+	return stop;
+}
+
+int serveSocket(const char *path, const timing_constraints *constraints, int slack_on){
+	// serve clients on the Unix socket path until one sends shutdown, returns 0 on an error
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		printf("Error: socket path %s is too long\n", path);
+		return 0;
+	}
+	strcpy(addr.sun_path, path);
+	// a socket left by an earlier server is replaced, anything else is not touched
+	struct stat st;
+	if(lstat(path, &st) == 0){
+		if(!S_ISSOCK(st.st_mode)){
+			printf("Error: %s exists and is not a socket\n", path);
+			return 0;
+		}
+		unlink(path);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0){
+		printf("Error: cannot listen on %s (%s)\n", path, strerror(errno));
+		if(fd >= 0) close(fd);
+		return 0;
+	}
+	// a client hanging up mid-reply is its problem, not the server's
+	signal(SIGPIPE, SIG_IGN);
+	printf("serve: listening on %s\n", path);
+	fflush(stdout);
+
+	serve_state s;
+	memset(&s, 0, sizeof(s));
+	s.constraints = constraints;
+	s.slack_on = slack_on;
+	int stop = 0, ok = 1;
+	while(!stop){
+		int client = accept(fd, NULL, NULL);
+		if(client < 0){
+			if(errno == EINTR) continue;
+			printf("Error: accept on %s (%s)\n", path, strerror(errno));
+			ok = 0;
+			break;
+		}
+		stop = serveClient(&s, client);
+	}
+	close(fd);
+	unlink(path);
+	designFree(&s);
+	free(s.po);
+	free(s.stamp);
+	return ok;
+}
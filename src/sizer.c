@@ -0,0 +1,548 @@
+#include "ace.h"
+
+// Lagrangian relaxation sizer (--sizer lr).
+// Every fanin edge of a GATE/PO carries a multiplier lambda. Multipliers are
+// scaled by how critical their edge is (arrival / required at the edge end)
+// and then projected back onto flow conservation: the multipliers entering a
+// node sum to those leaving it, so the POs are the only sources. The relaxed
+// problem then splits per cell: each NAND/INV independently takes the cell
+// minimizing area + mu * delay, where mu is the flow through that cell.
+// Cell loads only depend on fanout counts, so a resize never changes another
+// cell's delay and the incremental STA only re-times the affected cones.
+// The best solution meeting the target is kept; optimization() then spends
+// whatever slack is left on it.
+
+#define LR_GAMMA 2.0	// exponent of the criticality update, larger reacts faster
+#define LR_STALL 200	// iterations without a better feasible area before stopping
+
+static int cheapestCell(const lib_cell *cells, int count, const short *pareto, int pareto_n, const double *delay, double mu){
+	// cell minimizing area + mu * delay over the Pareto front of one load
+	int best = pareto[0];
+	PROF_COUNT(PROF_CELLS, pareto_n);
+	double best_cost = cells[best].area + mu * delay[best];
+	for(int k = 1; k < pareto_n; k++){
+		int c = pareto[k];
+		double cost = cells[c].area + mu * delay[c];
+		if(cost < best_cost){
+			best_cost = cost;
+			best = c;
+		}
+	}
+	return best;
+}
+
+static int cheapestInv(int load, double mu){
+	return cheapestCell(inverters, inv_count, libt.inv_pareto + load*inv_count, libt.inv_pareto_n[load],
+		libt.inv_delay + load*inv_count, mu);
+}
+
+static int cheapestNand(int load, double mu){
+	return cheapestCell(nands, nand_count, libt.nand_pareto + load*nand_count, libt.nand_pareto_n[load],
+		libt.nand_delay + load*nand_count, mu);
+}
+
+static double criticality(double arrival, double required){
+	// (arrival / required)^LR_GAMMA at the end of an edge, clamped so one pass can't zero or explode a multiplier
+	double crit = required > 0.0 ? arrival / required : 2.0;
+	crit = min(max(crit, 0.5), 2.0);
+	return pow(crit, LR_GAMMA);
+}
+
+static void updateMultipliers(timing_graph *g, double *lambda0, double *lambda1, double *flow){
+	// scale by criticality, then project onto flow conservation from the POs backwards
+	PROF_COUNT(PROF_NODES, g->n);
+	for(int i = g->n - 1; i >= 0; i--){
+		if(g->type[i] == PI) continue;
+		int in0 = g->fanin0[i];
+		if(in0 < 0) continue; // constant output
+		if(g->type[i] == PO){
+			lambda0[i] *= criticality(g->arrival[i], g->required[i]);
+			lambda0[i] = max(lambda0[i], 1e-12);
+			flow[i] = lambda0[i];
+			continue;
+		}
+		if(g->type[i] == INVERTER){
+			// one pin, all the flow leaving the inverter goes through it
+			double out = 0.0;
+			for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+				int fo = g->fanout[k];
+				if(g->fanin0[fo] == i) out += lambda0[fo];
+				if(g->type[fo] == GATE && g->fanin1[fo] == i) out += lambda1[fo];
+			}
+			lambda0[i] = flow[i] = out;
+			continue;
+		}
+		int in1 = g->fanin1[i];
+		double nand_delay = nandDelay(g, i, g->nand_id[i]);
+		double a0 = g->arrival[in0] + (COMPL0(g, i) ? invDelay(g->inv0_id[i]) : 0.0) + nand_delay;
+		double a1 = g->arrival[in1] + (COMPL1(g, i) ? invDelay(g->inv1_id[i]) : 0.0) + nand_delay;
+		double l0 = lambda0[i] * criticality(a0, g->required[i]);
+		double l1 = lambda1[i] * criticality(a1, g->required[i]);
+
+		// flow leaving i, its fanouts are already projected
+		double out = 0.0;
+		for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+			int fo = g->fanout[k];
+			if(g->fanin0[fo] == i) out += lambda0[fo];
+			if(g->type[fo] != PO && g->fanin1[fo] == i) out += lambda1[fo];
+		}
+		if(l0 + l1 > 0.0){
+			lambda0[i] = out * l0 / (l0 + l1);
+			lambda1[i] = out * l1 / (l0 + l1);
+		}else{
+			lambda0[i] = lambda1[i] = out * 0.5;
+		}
+		flow[i] = out;
+	}
+}
+
+static int resizeCells(timing_graph *g, const double *lambda0, const double *lambda1, const double *flow){
+	// solve the relaxed problem cell by cell, returns the number of cells swapped
+	int changed = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		if(COMPL0(g, i)){
+			int c = cheapestInv(INV_LOAD(g, i), lambda0[i]);
+			if(c != g->inv0_id[i]){
+				staResize(g, i, STA_INV0, c);
+				changed++;
+			}
+		}
+		if(g->type[i] != GATE) continue;
+		if(COMPL1(g, i)){
+			int c = cheapestInv(1, lambda1[i]);
+			if(c != g->inv1_id[i]){
+				staResize(g, i, STA_INV1, c);
+				changed++;
+			}
+		}
+		int c = cheapestNand(FANOUT_NUM(g, i), flow[i]);
+		if(c != g->nand_id[i]){
+			staResize(g, i, STA_NAND, c);
+			changed++;
+		}
+	}
+	return changed;
+}
+
+static double repairedArea(timing_graph *g, double tolerance, short *nand, short *inv0, short *inv1){
+	// area once every cell with negative slack is set to its fastest size. Every cell on a
+	// violating path has negative slack and delays only go down, so the result meets the
+	// target. The repaired sizes are written to nand/inv0/inv1 unless they are NULL.
+	double area = 0.0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		int in0 = g->fanin0[i];
+		if(g->type[i] == PO || g->type[i] == INVERTER){
+			int c = g->inv0_id[i];
+			if(COMPL0(g, i) && c >= 0){
+				if(g->arrival[i] > g->required[i] + tolerance) c = libt.inv_fastest[INV_LOAD(g, i)];
+				area += inverters[c].area;
+				if(inv0) inv0[i] = c;
+			}
+			continue;
+		}
+		int in1 = g->fanin1[i];
+		int load = FANOUT_NUM(g, i);
+		double nand_required = g->required[i] - nandDelay(g, i, g->nand_id[i]);
+		int c = g->nand_id[i];
+		if(g->arrival[i] > g->required[i] + tolerance) c = libt.nand_fastest[load];
+		area += nands[c].area;
+		if(nand) nand[i] = c;
+		if(COMPL0(g, i) && g->inv0_id[i] >= 0){
+			c = g->inv0_id[i];
+			if(g->arrival[in0] + invDelay(c) > nand_required + tolerance) c = libt.inv_fastest[1];
+			area += inverters[c].area;
+			if(inv0) inv0[i] = c;
+		}
+		if(COMPL1(g, i) && g->inv1_id[i] >= 0){
+			c = g->inv1_id[i];
+			if(g->arrival[in1] + invDelay(c) > nand_required + tolerance) c = libt.inv_fastest[1];
+			area += inverters[c].area;
+			if(inv1) inv1[i] = c;
+		}
+	}
+	return area;
+}
+
+int sizeLR(timing_graph *g, double target, double budget){
+	// Lagrangian relaxation sizing against max PO arrival <= target, runs at most budget seconds,
+	// leaves the best feasible cells in g with arrival/required times for target, returns the iteration count
+	double t_start = wallTime();
+	double *lambda0 = malloc(g->n * sizeof(double));
+	double *lambda1 = malloc(g->n * sizeof(double));
+	double *flow = malloc(g->n * sizeof(double));
+	short *best_nand = malloc(g->n * sizeof(short));
+	short *best_inv0 = malloc(g->n * sizeof(short));
+	short *best_inv1 = malloc(g->n * sizeof(short));
+	if(!lambda0 || !lambda1 || !flow || !best_nand || !best_inv0 || !best_inv1){
+		printf("Error: out of memory for the sizer\n");
+		exit(1);
+	}
+
+	// start from the current (fastest) cells, which meet the target by construction
+	staFull(g, target);
+	int npo = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PO) npo++;
+	}
+	// initial flow: every PO gets an equal share scaled to area per unit delay,
+	// so mu * delay starts on the order of a cell's area
+	double lambda_po = graphArea(g) / target / max(npo, 1);
+	for(unsigned int i = 0; i < g->n; i++){
+		lambda0[i] = lambda1[i] = g->type[i] == PO ? lambda_po : 1.0;
+	}
+	memcpy(best_nand, g->nand_id, g->n * sizeof(short));
+	memcpy(best_inv0, g->inv0_id, g->n * sizeof(short));
+	memcpy(best_inv1, g->inv1_id, g->n * sizeof(short));
+	double best_area = graphArea(g);
+	double tolerance = target * 1e-9;
+
+	int iter = 0, stall = 0;
+	while(wallTime() - t_start < budget && stall < LR_STALL){
+		iter++;
+		updateMultipliers(g, lambda0, lambda1, flow);
+		resizeCells(g, lambda0, lambda1, flow);
+		staUpdate(g);
+
+		// the relaxed solution usually misses the target on a few paths, judge it once repaired
+		double area = repairedArea(g, tolerance, NULL, NULL, NULL);
+		if(area < best_area){
+			best_area = area;
+			memcpy(best_nand, g->nand_id, g->n * sizeof(short));
+			memcpy(best_inv0, g->inv0_id, g->n * sizeof(short));
+			memcpy(best_inv1, g->inv1_id, g->n * sizeof(short));
+			repairedArea(g, tolerance, best_nand, best_inv0, best_inv1);
+			stall = 0;
+		}else{
+			stall++;
+		}
+	}
+
+	memcpy(g->nand_id, best_nand, g->n * sizeof(short));
+	memcpy(g->inv0_id, best_inv0, g->n * sizeof(short));
+	memcpy(g->inv1_id, best_inv1, g->n * sizeof(short));
+	staFull(g, target);
+
+	free(lambda0);
+	free(lambda1);
+	free(flow);
+	free(best_nand);
+	free(best_inv0);
+	free(best_inv1);
+	return iter;
+}
+
+//***********************************************************
+// exact tree sizing (--sizer dp)
+// The graph is cut at multi-fanout nodes: a GATE with exactly one fanout is
+// inside the tree of that fanout, every other GATE and every PO roots a tree
+// whose leaves are PIs and the roots of other trees. Roots are sized in index
+// (topological) order, so leaf arrivals are final when a tree is solved.
+// Each tree is solved bottom-up with a Pareto curve of (arrival, area) per
+// node; points later than the node's required time from initialDelay() can
+// never meet the target and are dropped, the rest are pruned to strictly
+// decreasing area. The root takes its cheapest point and the choices are
+// traced back down. Curves of one tree live in a pooled arena that is reset,
+// not freed, between trees.
+
+#define DP_PASSES 16	// upper bound on re-solving passes
+
+typedef struct dp_point{
+	double arrival;
+	double area;	// cells of the subtree below and including this point
+	int pick0;	// node point: pin0 point / pin point: child point, -1: leaf
+	int pick1;	// node point: pin1 point
+	short cell;	// node point: NAND / pin point: inverter, -1: no inverter
+} dp_point;
+
+static __thread struct{
+	// one per thread, so --batch workers can size circuits concurrently
+	dp_point *p;	// curves of the tree being solved
+	size_t n, cap;
+	dp_point *scratch;	// candidates before pruning
+	size_t scratch_n, scratch_cap;
+	// per node, valid for the nodes of the current tree
+	int *curve;	// offset of the node's curve in p
+	int *curve_n;
+	int *pin_curve;	// pin_curve[2*node + pin]: offset of the curve at a NAND input
+	double *required;	// arrival bound of the node in any sizing of the tree
+	double *budget;	// arrival the root aims for in the first pass
+	int *order;
+	int *stack;
+} dp;
+
+static dp_point *dpScratch(size_t need){
+	if(need > dp.scratch_cap){
+		dp.scratch_cap = max(need, dp.scratch_cap * 2 + 64);
+		dp.scratch = realloc(dp.scratch, dp.scratch_cap * sizeof(dp_point));
+		if(!dp.scratch){
+			printf("Error: out of memory for the sizer\n");
+			exit(1);
+		}
+	}
+	return dp.scratch;
+}
+
+static int dpCompare(const void *a, const void *b){
+	const dp_point *x = a, *y = b;
+	if(x->arrival != y->arrival) return x->arrival < y->arrival ? -1 : 1;
+	if(x->area != y->area) return x->area < y->area ? -1 : 1;
+	return 0;
+}
+
+static int dpPrune(double required, int *count){
+	// sort the scratch candidates, move the Pareto points meeting required into the arena,
+	// returns the curve offset. With no point meeting required the fastest one is kept.
+	dp_point *c = dp.scratch;
+	int n = dp.scratch_n;
+	qsort(c, n, sizeof(dp_point), dpCompare);
+	if(dp.n + n > dp.cap){
+		dp.cap = max(dp.n + n, dp.cap * 2 + 1024);
+		dp.p = realloc(dp.p, dp.cap * sizeof(dp_point));
+		if(!dp.p){
+			printf("Error: out of memory for the sizer\n");
+			exit(1);
+		}
+	}
+	int start = dp.n;
+	for(int k = 0; k < n; k++){
+		if(c[k].arrival > required && dp.n > (size_t)start) break;
+		if(dp.n > (size_t)start && c[k].area >= dp.p[dp.n - 1].area) continue;
+		dp.p[dp.n++] = c[k];
+	}
+	*count = dp.n - start;
+	return start;
+}
+
+static int dpInTree(timing_graph *g, int i){
+	// a NAND or shared inverter with one fanout is solved inside its fanout's tree
+	return (g->type[i] == GATE || g->type[i] == INVERTER) && FANOUT_NUM(g, i) == 1;
+}
+
+static int dpPin(timing_graph *g, int node, int pin, int *count){
+	// curve seen at one NAND input (or the PO / shared inverter input): the fanin's curve or arrival,
+	// through each inverter if inverted
+	int in = pin == 0 ? g->fanin0[node] : g->fanin1[node];
+	int inverted = pin == 0 ? COMPL0(g, node) : COMPL1(g, node);
+	int child = dpInTree(g, in);
+	dp_point leaf = {g->arrival[in], 0.0, -1, -1, -1};
+	int n = child ? dp.curve_n[in] : 1;
+	int load = INV_LOAD(g, node);
+	int cells = inverted ? libt.inv_pareto_n[load] : 1;
+	PROF_COUNT(PROF_CELLS, inverted ? cells : 0);
+	dpScratch(n * cells);
+	dp.scratch_n = 0;
+	for(int k = 0; k < n; k++){
+		dp_point p = child ? dp.p[dp.curve[in] + k] : leaf;
+		p.pick0 = child ? k : -1;
+		for(int j = 0; j < cells; j++){
+			dp_point q = p;
+			q.cell = -1;
+			if(inverted){
+				q.cell = libt.inv_pareto[load*inv_count + j];
+				q.arrival += INV_DELAY(load, q.cell);
+				q.area += inverters[q.cell].area;
+			}
+			dp.scratch[dp.scratch_n++] = q;
+		}
+	}
+	return dpPrune(DBL_MAX, count);
+}
+
+static int dpNode(timing_graph *g, int i, int pin0, int n0, int pin1, int n1, double required, int *count){
+	// NAND curve: for every cell, pair each arrival with the cheapest point of the other pin that is not later
+	int load = FANOUT_NUM(g, i);
+	int cells = libt.nand_pareto_n[load];
+	PROF_COUNT(PROF_CELLS, cells);
+	dpScratch((size_t)(n0 + n1) * cells);
+	dp.scratch_n = 0;
+	for(int j = 0; j < cells; j++){
+		int cell = libt.nand_pareto[load*nand_count + j];
+		double delay = nandDelay(g, i, cell);
+		int k0 = -1, k1 = -1;
+		while(k0 + 1 < n0 || k1 + 1 < n1){
+			// advance the pin whose next point arrives first
+			double next0 = k0 + 1 < n0 ? dp.p[pin0 + k0 + 1].arrival : DBL_MAX;
+			double next1 = k1 + 1 < n1 ? dp.p[pin1 + k1 + 1].arrival : DBL_MAX;
+			if(next0 <= next1) k0++;
+			if(next1 <= next0) k1++;
+			if(k0 < 0 || k1 < 0) continue;
+			const dp_point *p0 = &dp.p[pin0 + k0], *p1 = &dp.p[pin1 + k1];
+			dp_point q = {max(p0->arrival, p1->arrival) + delay, p0->area + p1->area + nands[cell].area, k0, k1, cell};
+			dp.scratch[dp.scratch_n++] = q;
+		}
+	}
+	return dpPrune(required, count);
+}
+
+static void dpTrace(timing_graph *g, int root, int point){
+	// apply the cells of one point of root's curve to the whole tree
+	int *stack = dp.stack, n = 0;
+	stack[n++] = root;
+	stack[n++] = point;
+	while(n > 0){
+		int k = stack[--n];
+		int i = stack[--n];
+		const dp_point *p = &dp.p[dp.curve[i] + k];
+		g->arrival[i] = p->arrival;
+		int pins = g->type[i] == GATE ? 2 : 1;
+		if(g->type[i] == GATE){
+			PROF_COUNT(PROF_SWAPS, g->nand_id[i] != p->cell);
+			g->nand_id[i] = p->cell;
+		}
+		for(int pin = 0; pin < pins; pin++){
+			// a PO's (or shared inverter's) curve is its pin curve
+			const dp_point *q = g->type[i] != GATE ? p : &dp.p[dp.pin_curve[2*i + pin] + (pin == 0 ? p->pick0 : p->pick1)];
+			if(q->cell >= 0){
+				short *inv = pin == 0 ? &g->inv0_id[i] : &g->inv1_id[i];
+				PROF_COUNT(PROF_SWAPS, *inv != q->cell);
+				*inv = q->cell;
+			}
+			if(q->pick0 >= 0){
+				stack[n++] = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+				stack[n++] = q->pick0;
+			}
+		}
+	}
+}
+
+static double dpPass(timing_graph *g, double target, int budgeted){
+	// solve every tree once against the current required times, returns the new area.
+	// budgeted: a root takes the cheapest point arriving by its budget (or its fastest point)
+	double tolerance = target * 1e-9;
+	int *order = dp.order, *stack = dp.stack;
+	double *required = dp.required;
+	for(unsigned int root = 0; root < g->n; root++){
+		if(g->type[root] == PI || g->fanin0[root] < 0) continue;
+		if(dpInTree(g, root)) continue; // inside its fanout's tree
+		dp.n = 0;
+
+		// collect the tree fanouts first; a tree node has a single path to the root, so
+		// required minus the fastest cells on that path bounds its arrival in any sizing
+		int n = 0, top = 0;
+		stack[top++] = root;
+		required[root] = g->required[root];
+		while(top > 0){
+			int i = stack[--top];
+			order[n++] = i;
+			double nand_required = required[i] - (g->type[i] != GATE ? 0.0 : nandDelay(g, i, libt.nand_fastest[FANOUT_NUM(g, i)]));
+			for(int pin = 0; pin < (g->type[i] == GATE ? 2 : 1); pin++){
+				int in = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+				if(!dpInTree(g, in)) continue;
+				int inverted = pin == 0 ? COMPL0(g, i) : COMPL1(g, i);
+				required[in] = nand_required - (inverted ? nodeInvDelay(g, i, libt.inv_fastest[INV_LOAD(g, i)]) : 0.0);
+				stack[top++] = in;
+			}
+		}
+		PROF_COUNT(PROF_NODES, n);
+		for(int k = n - 1; k >= 0; k--){
+			int i = order[k];
+			int n0, n1 = 0;
+			dp.pin_curve[2*i] = dpPin(g, i, 0, &n0);
+			if(g->type[i] != GATE){
+				// the pin curve is the PO's (or shared inverter's) curve
+				dp.curve[i] = dp.pin_curve[2*i];
+				int count = 0;
+				while(count < n0 && dp.p[dp.curve[i] + count].arrival <= required[i] + tolerance) count++;
+				dp.curve_n[i] = max(count, 1);
+				continue;
+			}
+			dp.pin_curve[2*i + 1] = dpPin(g, i, 1, &n1);
+			dp.curve[i] = dpNode(g, i, dp.pin_curve[2*i], n0, dp.pin_curve[2*i + 1], n1, required[i] + tolerance, &dp.curve_n[i]);
+		}
+		// points are in increasing arrival and decreasing area, the last one is the cheapest
+		int pick = dp.curve_n[root] - 1;
+		if(budgeted){
+			while(pick > 0 && dp.p[dp.curve[root] + pick].arrival > dp.budget[root] + tolerance) pick--;
+		}
+		dpTrace(g, root, pick);
+	}
+	staFull(g, target);
+	return graphArea(g);
+}
+
+static double dpRun(timing_graph *g, double target, int budgeted, int *passes){
+	// first pass, then re-solve against the required times of the previous result until
+	// area stops going down: that result still meets them, so area never goes up
+	double area = dpPass(g, target, budgeted);
+	*passes = 1;
+	while(*passes < DP_PASSES){
+		(*passes)++;
+		double area_new = dpPass(g, target, 0);
+		if(area_new > area - 1e-9) break;
+		area = area_new;
+	}
+	return area;
+}
+
+int sizeDP(timing_graph *g, double target){
+	// exact min-area sizing of every fanout-free tree, starting from the cells and required
+	// times of initialDelay(). Leaves the smaller of two runs in g with arrival/required
+	// times for target: one where the first pass gives every root its full slack, and one
+	// where a root only gets the share of its slack proportional to the delay in front of
+	// it, so early trees don't starve the ones behind them. Returns the pass count.
+	dp.curve = malloc(g->n * sizeof(int));
+	dp.curve_n = malloc(g->n * sizeof(int));
+	dp.pin_curve = malloc(2 * g->n * sizeof(int));
+	dp.order = malloc(g->n * sizeof(int));
+	dp.stack = malloc(2 * g->n * sizeof(int));
+	dp.required = malloc(g->n * sizeof(double));
+	dp.budget = malloc(g->n * sizeof(double));
+	short *start_nand = malloc(g->n * sizeof(short));
+	short *start_inv0 = malloc(g->n * sizeof(short));
+	short *start_inv1 = malloc(g->n * sizeof(short));
+	if(!dp.curve || !dp.curve_n || !dp.pin_curve || !dp.order || !dp.stack || !dp.required || !dp.budget ||
+	   !start_nand || !start_inv0 || !start_inv1){
+		printf("Error: out of memory for the sizer\n");
+		exit(1);
+	}
+	for(unsigned int i = 0; i < g->n; i++){
+		double ahead = target - g->required[i];
+		double total = g->arrival[i] + ahead;
+		dp.budget[i] = total > 0.0 ? g->arrival[i] + (g->required[i] - g->arrival[i]) * g->arrival[i] / total : g->required[i];
+	}
+	memcpy(start_nand, g->nand_id, g->n * sizeof(short));
+	memcpy(start_inv0, g->inv0_id, g->n * sizeof(short));
+	memcpy(start_inv1, g->inv1_id, g->n * sizeof(short));
+
+	int passes, passes_full;
+	double area = dpRun(g, target, 1, &passes);
+	// keep the budgeted result in the start arrays, swap it back if the full-slack run loses
+	for(unsigned int i = 0; i < g->n; i++){
+		short t;
+		t = start_nand[i]; start_nand[i] = g->nand_id[i]; g->nand_id[i] = t;
+		t = start_inv0[i]; start_inv0[i] = g->inv0_id[i]; g->inv0_id[i] = t;
+		t = start_inv1[i]; start_inv1[i] = g->inv1_id[i]; g->inv1_id[i] = t;
+	}
+	staFull(g, target);
+	double area_full = dpRun(g, target, 0, &passes_full);
+	passes += passes_full;
+	if(area < area_full){
+		memcpy(g->nand_id, start_nand, g->n * sizeof(short));
+		memcpy(g->inv0_id, start_inv0, g->n * sizeof(short));
+		memcpy(g->inv1_id, start_inv1, g->n * sizeof(short));
+		staFull(g, target);
+	}
+
+	free(dp.curve);
+	free(dp.curve_n);
+	free(dp.pin_curve);
+	free(dp.order);
+	free(dp.stack);
+	free(dp.required);
+	free(dp.budget);
+	free(start_nand);
+	free(start_inv0);
+	free(start_inv1);
+	return passes;
+}
+
+void sizerThreadDone(){
+	// release the calling thread's curve arena, kept between sizeDP() calls; call before a
+	// thread that ran sizeDP() exits
+	free(dp.p);
+	free(dp.scratch);
+	dp.p = dp.scratch = NULL;
+	dp.n = dp.cap = dp.scratch_n = dp.scratch_cap = 0;
+}
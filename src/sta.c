@@ -0,0 +1,486 @@
+#include <pthread.h>
+#include "ace.h"
+
+// Incremental static timing over timing_graph.
+// Node indices are already a topological order, so the dirty frontier is kept
+// in two binary heaps keyed by node index: arrivals are re-timed in increasing
+// index order (forward cone), required times in decreasing order (backward cone).
+// A node only pushes its neighbours when its own value actually changed, so an
+// update stops as soon as a swap is absorbed by a max()/min() somewhere.
+// Full passes walk the level buckets instead and split every level across a
+// small thread pool; each node only reads lower (forward) or higher (backward)
+// levels, so the result does not depend on the thread count. They run on the
+// level_nodes positions (sta_layout), where every level is contiguous: the
+// delays of the current cells are packed there first and each level is timed
+// by the vector kernels of stavec.c.
+
+struct sta_state{
+	unsigned int cap;	// node capacity the queues are sized for
+	unsigned char *queued;	// bit0: in forward heap, bit1: in backward heap
+	int *fwd;	// min-heap of node indices whose arrival must be recomputed
+	int fwd_n;
+	int *bwd;	// max-heap of node indices whose required time must be recomputed
+	int bwd_n;
+	sta_layout layout;	// full passes
+};
+
+//***********************************************************
+// delay model
+double invDelay(int inv_id){
+	// inverters drive a fixed load of one
+	if(inv_id < 0) return 0.0;
+	return INV_DELAY(1, inv_id);
+}
+
+double nodeInvDelay(timing_graph *g, int node, int inv_id){
+	// delay of an inverter on node's fanin, at the load it drives
+	if(inv_id < 0) return 0.0;
+	return INV_DELAY(INV_LOAD(g, node), inv_id);
+}
+
+double nandDelay(timing_graph *g, int node, int nand_id){
+	return NAND_DELAY(FANOUT_NUM(g, node), nand_id);
+}
+
+static double edgeDelay(timing_graph *g, int node, int pin){
+	// delay from fanin pin of node to the node output
+	int inv_id = pin == 0 ? g->inv0_id[node] : g->inv1_id[node];
+	int inverted = pin == 0 ? COMPL0(g, node) : COMPL1(g, node);
+	if(g->type[node] == PO || g->type[node] == INVERTER){
+		return inverted ? nodeInvDelay(g, node, inv_id) : 0.0;
+	}
+	// same association as initialDelay() so both passes agree bit for bit
+	if(inverted) return nandDelay(g, node, g->nand_id[node]) + inverters[inv_id].timing[0] + inverters[inv_id].timing[1];
+	return nandDelay(g, node, g->nand_id[node]);
+}
+
+static double nodeArrival(timing_graph *g, int i){
+	if(g->type[i] == PI) return g->arrival[i];
+	if(g->fanin0[i] < 0) return 0.0; // constant output
+	double a0 = g->arrival[g->fanin0[i]];
+	if(COMPL0(g, i)) a0 += nodeInvDelay(g, i, g->inv0_id[i]);
+	if(g->type[i] == PO || g->type[i] == INVERTER) return a0;
+	double a1 = g->arrival[g->fanin1[i]];
+	if(COMPL1(g, i)) a1 += invDelay(g->inv1_id[i]);
+	return max(a0, a1) + nandDelay(g, i, g->nand_id[i]);
+}
+
+static double nodeRequired(timing_graph *g, int i){
+	// POs keep the required time they were given, others take the min over their fanouts
+	if(g->type[i] == PO) return g->required[i];
+	double required = DBL_MAX;
+	for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+		int fo = g->fanout[k];
+		if(g->fanin0[fo] == i) required = min(g->required[fo] - edgeDelay(g, fo, 0), required);
+		if(g->fanin1[fo] == i) required = min(g->required[fo] - edgeDelay(g, fo, 1), required);
+	}
+	return required;
+}
+
+//***********************************************************
+// dirty queues
+static void heapPush(int *heap, int *n, int v, int sign){
+	// sign = 1: min-heap, sign = -1: max-heap
+	int k = (*n)++;
+	while(k > 0){
+		int parent = (k - 1) / 2;
+		if(sign * heap[parent] <= sign * v) break;
+		heap[k] = heap[parent];
+		k = parent;
+	}
+	heap[k] = v;
+}
+
+static int heapPop(int *heap, int *n, int sign){
+	int top = heap[0];
+	int v = heap[--(*n)];
+	int k = 0;
+	while(2*k + 1 < *n){
+		int child = 2*k + 1;
+		if(child + 1 < *n && sign * heap[child + 1] < sign * heap[child]) child++;
+		if(sign * v <= sign * heap[child]) break;
+		heap[k] = heap[child];
+		k = child;
+	}
+	heap[k] = v;
+	return top;
+}
+
+static void markArrival(timing_graph *g, int i){
+	struct sta_state *s = g->sta;
+	if(s->queued[i] & 1) return;
+	s->queued[i] |= 1;
+	heapPush(s->fwd, &s->fwd_n, i, 1);
+}
+
+static void markRequired(timing_graph *g, int i){
+	struct sta_state *s = g->sta;
+	if(s->queued[i] & 2) return;
+	s->queued[i] |= 2;
+	heapPush(s->bwd, &s->bwd_n, i, -1);
+}
+
+//***********************************************************
+// interface
+void staInit(timing_graph *g){
+	// (re)size the queues to the graph capacity, pending marks are kept
+	struct sta_state *s = g->sta;
+	if(s && s->cap >= g->cap) return;
+	if(!s){
+		s = calloc(1, sizeof(*s));
+		g->sta = s;
+	}
+	s->queued = realloc(s->queued, g->cap * sizeof(*s->queued));
+	s->fwd = realloc(s->fwd, g->cap * sizeof(*s->fwd));
+	s->bwd = realloc(s->bwd, g->cap * sizeof(*s->bwd));
+	if(!s->queued || !s->fwd || !s->bwd){
+		printf("Error: out of memory for timing queues\n");
+		exit(1);
+	}
+	memset(s->queued + s->cap, 0, g->cap - s->cap);
+	s->cap = g->cap;
+}
+
+void staFree(timing_graph *g){
+	if(!g->sta) return;
+	free(g->sta->queued);
+	free(g->sta->fwd);
+	free(g->sta->bwd);
+	sta_layout *l = &g->sta->layout;
+	free(l->pos);
+	free(l->fanin);
+	free(l->sink_start);
+	free(l->sink);
+	free(l->delay);
+	free(l->node);
+	free(l->time);
+	free(g->sta);
+	g->sta = NULL;
+}
+
+//***********************************************************
+// level-parallel full passes
+#define STA_GRAIN 512 // nodes per thread below which a level is done by one thread
+
+static struct{
+	int n;	// thread count including the caller
+	pthread_t *tid;
+	pthread_barrier_t barrier;
+	timing_graph *g;
+	int backward;	// pass to run, -1: workers exit
+	double target;
+} pool = {1};
+
+static void layoutBuild(timing_graph *g){
+	// level_nodes positions of the nodes and the pins between them, once per graph structure
+	sta_layout *l = &g->sta->layout;
+	int n = l->n = g->n;
+	l->pos = realloc(l->pos, n * sizeof(int));
+	l->fanin = realloc(l->fanin, 2 * n * sizeof(int));
+	l->sink_start = realloc(l->sink_start, (n + 1) * sizeof(int));
+	l->delay = realloc(l->delay, 2 * n * sizeof(double));
+	l->node = realloc(l->node, n * sizeof(double));
+	l->time = realloc(l->time, n * sizeof(double));
+	if(!l->pos || !l->fanin || !l->sink_start || !l->delay || !l->node || !l->time){
+		printf("Error: out of memory for the timing layout\n");
+		exit(1);
+	}
+	for(int k = 0; k < n; k++) l->pos[g->level_nodes[k]] = k;
+	memset(l->sink_start, 0, (n + 1) * sizeof(int));
+	for(int k = 0; k < n; k++){
+		int i = g->level_nodes[k];
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			l->fanin[k] = l->fanin[n + k] = k;	// never read, levels above 0 only
+			continue;
+		}
+		l->fanin[k] = l->pos[g->fanin0[i]];
+		l->fanin[n + k] = g->type[i] == GATE ? l->pos[g->fanin1[i]] : l->fanin[k];
+		l->sink_start[l->fanin[k] + 1]++;
+		if(g->type[i] == GATE) l->sink_start[l->fanin[n + k] + 1]++;
+	}
+	for(int k = 0; k < n; k++) l->sink_start[k + 1] += l->sink_start[k];
+	l->sink = realloc(l->sink, max(l->sink_start[n], 1) * sizeof(int));
+	int *fill = malloc((n + 1) * sizeof(int));
+	if(!l->sink || !fill){
+		printf("Error: out of memory for the timing layout\n");
+		exit(1);
+	}
+	memcpy(fill, l->sink_start, (n + 1) * sizeof(int));
+	for(int k = 0; k < n; k++){
+		int i = g->level_nodes[k];
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		l->sink[fill[l->fanin[k]]++] = k;
+		if(g->type[i] == GATE) l->sink[fill[l->fanin[n + k]]++] = n + k;
+	}
+	free(fill);
+}
+
+static void layoutPack(timing_graph *g, int backward, double target, int lo, int hi){
+	// delays of the current cells of nodes lo..hi-1 at their positions, see sta_layout. Nodes
+	// are read in index order and without branches on their type: a missing cell reads cell 0
+	// and counts 0 times, the same association as nodeArrival() and edgeDelay()
+	sta_layout *l = &g->sta->layout;
+	int n = l->n;
+	for(int i = lo; i < hi; i++){
+		int k = l->pos[i];
+		int gate = g->type[i] == GATE;
+		int inv0 = max(g->inv0_id[i], 0), inv1 = max(g->inv1_id[i], 0);
+		double has0 = COMPL0(g, i) & (g->inv0_id[i] >= 0);
+		double has1 = gate & COMPL1(g, i) & (g->inv1_id[i] >= 0);
+		double inv0_delay = has0 * INV_DELAY(INV_LOAD(g, i), inv0);
+		double nand_delay = gate * NAND_DELAY(FANOUT_NUM(g, i), max(g->nand_id[i], 0));
+		if(backward){
+			l->node[k] = g->type[i] == PO ? PO_REQUIRED(g, i, target) : DBL_MAX;
+			l->delay[k] = gate ? (nand_delay + has0 * inverters[inv0].timing[0]) + has0 * inverters[inv0].timing[1] : inv0_delay;
+			l->delay[n + k] = (nand_delay + has1 * inverters[inv1].timing[0]) + has1 * inverters[inv1].timing[1];
+		}else{
+			l->delay[k] = inv0_delay;
+			l->delay[n + k] = has1 * INV_DELAY(1, inv1);
+			l->node[k] = nand_delay;
+			// PIs keep their arrival and constants arrive at 0, the kernels time the rest
+			l->time[k] = g->type[i] == PI ? g->arrival[i] : 0.0;
+		}
+	}
+}
+
+static void levelPass(timing_graph *g, int backward, double target, int worker, int nworker){
+	// pack the delays, time the levels in place, then hand the times back to the nodes
+	sta_layout *l = &g->sta->layout;
+	int chunk = (l->n + nworker - 1) / nworker;
+	int first = min(worker * chunk, l->n), last = min(first + chunk, l->n);
+	layoutPack(g, backward, target, first, last);
+	if(nworker > 1) pthread_barrier_wait(&pool.barrier);
+	// level 0 holds only PIs and constants, the forward pass has nothing to time there
+	for(int step = backward ? 0 : 1; step < g->nlevels; step++){
+		int level = backward ? g->nlevels - 1 - step : step;
+		int lo = g->level_start[level], hi = g->level_start[level + 1];
+		int count = hi - lo;
+		if(nworker > 1){
+			if(count < STA_GRAIN * 2){
+				if(worker != 0) count = 0;
+			}else{
+				int chunk = (count + nworker - 1) / nworker;
+				lo += worker * chunk;
+				count = min(chunk, hi - lo);
+			}
+		}
+		if(backward) staKernelBackward(l, lo, lo + count);
+		else staKernelForward(l, lo, lo + count);
+		if(nworker > 1) pthread_barrier_wait(&pool.barrier);
+	}
+	double *time = backward ? g->required : g->arrival;
+	for(int i = first; i < last; i++) time[i] = l->time[l->pos[i]];
+}
+
+static void *poolWorker(void *arg){
+	int worker = (int)(long)arg;
+	while(1){
+		pthread_barrier_wait(&pool.barrier);	// wait for a pass
+		if(pool.backward < 0) break;
+		levelPass(pool.g, pool.backward, pool.target, worker, pool.n);
+		pthread_barrier_wait(&pool.barrier);	// pass done
+	}
+	return NULL;
+}
+
+static void poolRun(timing_graph *g, int backward, double target){
+	PROF_COUNT(PROF_NODES, g->n);
+	staInit(g);
+	if(g->sta->layout.n != (int)g->n) layoutBuild(g);
+	if(pool.n <= 1){
+		levelPass(g, backward, target, 0, 1);
+		return;
+	}
+	pool.g = g;
+	pool.backward = backward;
+	pool.target = target;
+	pthread_barrier_wait(&pool.barrier);
+	levelPass(g, backward, target, 0, pool.n);
+	pthread_barrier_wait(&pool.barrier);
+}
+
+void staThreads(int n){
+	// (re)start the pool with n threads in total, n <= 1 runs full passes serially
+	if(pool.n > 1){
+		pool.backward = -1;
+		pthread_barrier_wait(&pool.barrier);
+		for(int w = 1; w < pool.n; w++) pthread_join(pool.tid[w], NULL);
+		pthread_barrier_destroy(&pool.barrier);
+		free(pool.tid);
+		pool.tid = NULL;
+	}
+	pool.n = max(n, 1);
+	if(pool.n <= 1) return;
+	pool.tid = malloc(pool.n * sizeof(pthread_t));
+	pthread_barrier_init(&pool.barrier, NULL, pool.n);
+	for(int w = 1; w < pool.n; w++){
+		if(pthread_create(&pool.tid[w], NULL, poolWorker, (void *)(long)w) != 0){
+			printf("Error: cannot start timing thread %d\n", w);
+			exit(1);
+		}
+	}
+}
+
+void staForward(timing_graph *g){
+	// arrival time of every node with the current cells
+	poolRun(g, 0, 0.0);
+}
+
+void staBackward(timing_graph *g, double target){
+	// required time of every node, POs are required at target
+	poolRun(g, 1, target);
+}
+
+void staFull(timing_graph *g, double target){
+	// full forward and backward pass with the current cells, drops pending incremental marks
+	staInit(g);
+	staForward(g);
+	staBackward(g, target);
+	g->sta->fwd_n = g->sta->bwd_n = 0;
+	memset(g->sta->queued, 0, g->n);
+}
+
+void staResize(timing_graph *g, int node, int pin, int cell){
+	// swap one cell of node and mark what it invalidates, staUpdate() does the re-timing
+	staInit(g);
+	PROF_COUNT(PROF_SWAPS, 1);
+	if(pin == STA_NAND) g->nand_id[node] = cell;
+	else if(pin == STA_INV0) g->inv0_id[node] = cell;
+	else g->inv1_id[node] = cell;
+
+	// the swap changes this node's arrival and the required time seen by its fanins;
+	// cell loads don't depend on sizes, so nothing upstream of the fanins moves
+	markArrival(g, node);
+	if(g->fanin0[node] >= 0) markRequired(g, g->fanin0[node]);
+	if(g->fanin1[node] >= 0) markRequired(g, g->fanin1[node]);
+}
+
+void staTouch(timing_graph *g, int node){
+	// node's fanins or load changed (an edit of the structure): mark its arrival, its required
+	// time and the required times its fanins see, staUpdate() does the re-timing
+	staInit(g);
+	markArrival(g, node);
+	markRequired(g, node);
+	if(g->fanin0[node] >= 0) markRequired(g, g->fanin0[node]);
+	if(g->fanin1[node] >= 0) markRequired(g, g->fanin1[node]);
+}
+
+int staUpdate(timing_graph *g){
+	// propagate pending marks, returns the number of nodes re-timed
+	struct sta_state *s = g->sta;
+	int visited = 0;
+	if(!s) return 0;
+
+	while(s->fwd_n > 0){
+		int i = heapPop(s->fwd, &s->fwd_n, 1);
+		s->queued[i] &= ~1;
+		visited++;
+		double arrival = nodeArrival(g, i);
+		if(arrival == g->arrival[i]) continue;
+		g->arrival[i] = arrival;
+		for(int k = g->fanout_start[i]; k < g->fanout_start[i+1]; k++){
+			markArrival(g, g->fanout[k]);
+		}
+	}
+
+	while(s->bwd_n > 0){
+		int i = heapPop(s->bwd, &s->bwd_n, -1);
+		s->queued[i] &= ~2;
+		visited++;
+		double required = nodeRequired(g, i);
+		if(required == g->required[i]) continue;
+		g->required[i] = required;
+		if(g->fanin0[i] >= 0) markRequired(g, g->fanin0[i]);
+		if(g->fanin1[i] >= 0) markRequired(g, g->fanin1[i]);
+	}
+	PROF_COUNT(PROF_NODES, visited);
+	return visited;
+}
+
+void staSlacks(timing_graph *g){
+	// fill the slack columns written to .mbench from the current arrival/required times
+	for(unsigned int i = 0; i < g->n; i++){
+		int in0 = g->fanin0[i];
+		if(g->type[i] == PI || in0 < 0) continue;
+		if(g->type[i] == PO || g->type[i] == INVERTER){
+			if(COMPL0(g, i)) g->inv_slack0[i] = g->required[i] - (g->arrival[in0] + nodeInvDelay(g, i, g->inv0_id[i]));
+			continue;
+		}
+		int in1 = g->fanin1[i];
+		double nand_required = g->required[i] - nandDelay(g, i, g->nand_id[i]);
+		g->slack[i] = g->required[i] - g->arrival[i];
+		if(COMPL0(g, i)) g->inv_slack0[i] = nand_required - (g->arrival[in0] + invDelay(g->inv0_id[i]));
+		if(COMPL1(g, i)) g->inv_slack1[i] = nand_required - (g->arrival[in1] + invDelay(g->inv1_id[i]));
+	}
+}
+
+//***********************************************************
+// multi-corner timing
+static void cornerArcs(timing_graph *g, int i, double arc[6]){
+	// intrinsic and slope * load of node i's inverter 0, inverter 1 and NAND, zeros for no cell
+	memset(arc, 0, 6 * sizeof(double));
+	if(COMPL0(g, i) && g->inv0_id[i] >= 0){
+		arc[0] = inverters[g->inv0_id[i]].timing[0];
+		arc[1] = inverters[g->inv0_id[i]].timing[1] * INV_LOAD(g, i);
+	}
+	if(g->type[i] != GATE) return;
+	if(COMPL1(g, i) && g->inv1_id[i] >= 0){
+		arc[2] = inverters[g->inv1_id[i]].timing[0];
+		arc[3] = inverters[g->inv1_id[i]].timing[1];
+	}
+	arc[4] = nands[g->nand_id[i]].timing[0];
+	arc[5] = nands[g->nand_id[i]].timing[1] * FANOUT_NUM(g, i);
+}
+
+void staCorners(timing_graph *g, const timing_corner *corner, int nc, const double *port, const double *po_required,
+	double *arrival, double *required){
+	// arrival and required times of the current cells at nc corners in one forward and one
+	// backward pass. Times are node-major (arrival[i*nc + k]), so the inner loops run over
+	// contiguous corners without branches; port: PI arrivals or NULL; po_required: node-major
+	// output required times, NULL: arrival times only
+	double ci[CORNER_MAX], cs[CORNER_MAX];
+	for(int k = 0; k < nc; k++){
+		ci[k] = corner[k].intrinsic;
+		cs[k] = corner[k].slope;
+	}
+	double arc[6];
+	for(unsigned int i = 0; i < g->n; i++){
+		double *a = arrival + (size_t)i * nc;
+		if(g->type[i] == PI || g->fanin0[i] < 0){
+			double t = g->type[i] == PI && port ? port[i] : 0.0;
+			for(int k = 0; k < nc; k++) a[k] = t;
+			continue;
+		}
+		cornerArcs(g, i, arc);
+		const double *a0 = arrival + (size_t)g->fanin0[i] * nc;
+		if(g->type[i] != GATE){
+			for(int k = 0; k < nc; k++) a[k] = a0[k] + ci[k] * arc[0] + cs[k] * arc[1];
+			continue;
+		}
+		const double *a1 = arrival + (size_t)g->fanin1[i] * nc;
+		for(int k = 0; k < nc; k++){
+			double x0 = a0[k] + ci[k] * arc[0] + cs[k] * arc[1];
+			double x1 = a1[k] + ci[k] * arc[2] + cs[k] * arc[3];
+			a[k] = max(x0, x1) + ci[k] * arc[4] + cs[k] * arc[5];
+		}
+	}
+	if(!po_required) return;
+	for(size_t k = 0; k < (size_t)g->n * nc; k++) required[k] = DBL_MAX;
+	for(int i = g->n - 1; i >= 0; i--){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		double *r = required + (size_t)i * nc;
+		if(g->type[i] == PO) memcpy(r, po_required + (size_t)i * nc, nc * sizeof(double));
+		cornerArcs(g, i, arc);
+		double *r0 = required + (size_t)g->fanin0[i] * nc;
+		if(g->type[i] != GATE){
+			for(int k = 0; k < nc; k++) r0[k] = min(r0[k], r[k] - ci[k] * arc[0] - cs[k] * arc[1]);
+			continue;
+		}
+		double *r1 = required + (size_t)g->fanin1[i] * nc;
+		for(int k = 0; k < nc; k++){
+			double nand_required = r[k] - ci[k] * arc[4] - cs[k] * arc[5];
+			r0[k] = min(r0[k], nand_required - ci[k] * arc[0] - cs[k] * arc[1]);
+			r1[k] = min(r1[k], nand_required - ci[k] * arc[2] - cs[k] * arc[3]);
+		}
+	}
+}
@@ -0,0 +1,177 @@
+#include "ace.h"
+
+// Level kernels of the full timing passes (staForward()/staBackward()). They
+// run on a sta_layout, where the nodes of a level are contiguous and the delays
+// of the current cells are packed, so timing a node is the same branch-free
+// arithmetic whatever its type: a missing inverter is a zero delay, a PO or a
+// shared inverter reads its only fanin on both pins. The nodes of one level are
+// independent, so the vector kernels time 4 (AVX2) or 8 (AVX-512) of them per
+// instruction, gathering the fanin times forward and the times at the fanout
+// pins backward, lanes without a pin masked off. Every kernel does the same
+// operations as the scalar one and min()/max() don't round, so the times are
+// identical bit for bit; staKernel() picks one at run time.
+
+//***********************************************************
+// scalar
+static void forwardScalar(sta_layout *l, int lo, int hi){
+	int n = l->n;
+	for(int k = lo; k < hi; k++){
+		double a0 = l->time[l->fanin[k]] + l->delay[k];
+		double a1 = l->time[l->fanin[n + k]] + l->delay[n + k];
+		l->time[k] = max(a0, a1) + l->node[k];
+	}
+}
+
+static void backwardScalar(sta_layout *l, int lo, int hi){
+	int n = l->n;
+	for(int k = lo; k < hi; k++){
+		double required = l->node[k];
+		for(int e = l->sink_start[k]; e < l->sink_start[k+1]; e++) required = min(l->delay[l->sink[e]], required);
+		l->time[k] = required;
+		// the required time at the pins, read by the fanins on lower levels
+		l->delay[k] = required - l->delay[k];
+		l->delay[n + k] = required - l->delay[n + k];
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STA_X86
+
+//***********************************************************
+// AVX2: 4 nodes per step
+__attribute__((target("avx2")))
+static void forwardAvx2(sta_layout *l, int lo, int hi){
+	int n = l->n, k = lo;
+	for(; k + 4 <= hi; k += 4){
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(l->fanin + k));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(l->fanin + n + k));
+		__m256d a0 = _mm256_add_pd(_mm256_i32gather_pd(l->time, p0, 8), _mm256_loadu_pd(l->delay + k));
+		__m256d a1 = _mm256_add_pd(_mm256_i32gather_pd(l->time, p1, 8), _mm256_loadu_pd(l->delay + n + k));
+		_mm256_storeu_pd(l->time + k, _mm256_add_pd(_mm256_max_pd(a0, a1), _mm256_loadu_pd(l->node + k)));
+	}
+	forwardScalar(l, k, hi);
+}
+
+__attribute__((target("avx2")))
+static void backwardAvx2(sta_layout *l, int lo, int hi){
+	int n = l->n, k = lo;
+	for(; k + 4 <= hi; k += 4){
+		__m128i start = _mm_loadu_si128((const __m128i *)(l->sink_start + k));
+		__m128i end = _mm_loadu_si128((const __m128i *)(l->sink_start + k + 1));
+		__m256d r = _mm256_loadu_pd(l->node + k);
+		int count[4], most = 0;
+		_mm_storeu_si128((__m128i *)count, _mm_sub_epi32(end, start));
+		for(int w = 0; w < 4; w++) most = max(most, count[w]);
+		// sink j of every node at once, a lane out of sinks gathers its own time back
+		for(int j = 0; j < most; j++){
+			__m128i e = _mm_add_epi32(start, _mm_set1_epi32(j));
+			__m128i m = _mm_cmpgt_epi32(end, e);
+			__m128i sink = _mm_mask_i32gather_epi32(_mm_setzero_si128(), l->sink, e, m, 4);
+			__m256d m64 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(m));
+			r = _mm256_min_pd(_mm256_mask_i32gather_pd(r, l->delay, sink, m64, 8), r);
+		}
+		_mm256_storeu_pd(l->time + k, r);
+		_mm256_storeu_pd(l->delay + k, _mm256_sub_pd(r, _mm256_loadu_pd(l->delay + k)));
+		_mm256_storeu_pd(l->delay + n + k, _mm256_sub_pd(r, _mm256_loadu_pd(l->delay + n + k)));
+	}
+	backwardScalar(l, k, hi);
+}
+
+//***********************************************************
+// AVX-512: 8 nodes per step
+__attribute__((target("avx512f,avx512vl,avx2")))
+static void forwardAvx512(sta_layout *l, int lo, int hi){
+	int n = l->n, k = lo;
+	for(; k + 8 <= hi; k += 8){
+		__m256i p0 = _mm256_loadu_si256((const __m256i *)(l->fanin + k));
+		__m256i p1 = _mm256_loadu_si256((const __m256i *)(l->fanin + n + k));
+		__m512d a0 = _mm512_add_pd(_mm512_i32gather_pd(p0, l->time, 8), _mm512_loadu_pd(l->delay + k));
+		__m512d a1 = _mm512_add_pd(_mm512_i32gather_pd(p1, l->time, 8), _mm512_loadu_pd(l->delay + n + k));
+		_mm512_storeu_pd(l->time + k, _mm512_add_pd(_mm512_max_pd(a0, a1), _mm512_loadu_pd(l->node + k)));
+	}
+	forwardScalar(l, k, hi);
+}
+
+__attribute__((target("avx512f,avx512vl,avx2")))
+static void backwardAvx512(sta_layout *l, int lo, int hi){
+	int n = l->n, k = lo;
+	for(; k + 8 <= hi; k += 8){
+		__m256i start = _mm256_loadu_si256((const __m256i *)(l->sink_start + k));
+		__m256i end = _mm256_loadu_si256((const __m256i *)(l->sink_start + k + 1));
+		__m512d r = _mm512_loadu_pd(l->node + k);
+		int count[8], most = 0;
+		_mm256_storeu_si256((__m256i *)count, _mm256_sub_epi32(end, start));
+		for(int w = 0; w < 8; w++) most = max(most, count[w]);
+		for(int j = 0; j < most; j++){
+			__m256i e = _mm256_add_epi32(start, _mm256_set1_epi32(j));
+			__mmask8 m = _mm256_cmpgt_epi32_mask(end, e);
+			__m256i sink = _mm256_mmask_i32gather_epi32(_mm256_setzero_si256(), m, e, l->sink, 4);
+			r = _mm512_mask_min_pd(r, m, _mm512_mask_i32gather_pd(r, m, sink, l->delay, 8), r);
+		}
+		_mm512_storeu_pd(l->time + k, r);
+		_mm512_storeu_pd(l->delay + k, _mm512_sub_pd(r, _mm512_loadu_pd(l->delay + k)));
+		_mm512_storeu_pd(l->delay + n + k, _mm512_sub_pd(r, _mm512_loadu_pd(l->delay + n + k)));
+	}
+	backwardScalar(l, k, hi);
+}
+#endif
+
+//***********************************************************
+// dispatch
+typedef struct sta_kernel{
+	const char *name;
+	void (*forward)(sta_layout *l, int lo, int hi);
+	void (*backward)(sta_layout *l, int lo, int hi);
+} sta_kernel;
+
+static const sta_kernel kernels[] = {
+	{"scalar", forwardScalar, backwardScalar},
+#ifdef STA_X86
+	{"avx2", forwardAvx2, backwardAvx2},
+	{"avx512", forwardAvx512, backwardAvx512},
+#endif
+};
+#define KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static const sta_kernel *kernel;
+
+static int kernelSupported(const sta_kernel *k){
+#ifdef STA_X86
+	if(k->forward == forwardAvx2) return __builtin_cpu_supports("avx2");
+	if(k->forward == forwardAvx512) return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+#endif
+	return 1;
+}
+
+int staKernel(const char *name){
+	// select the full pass kernel by name, NULL or "auto": the widest the CPU runs; returns 0 if unavailable
+	int automatic = !name || strcmp(name, "auto") == 0;
+	for(int k = KERNELS - 1; k >= 0; k--){
+		if(!automatic && strcmp(name, kernels[k].name) != 0) continue;
+		if(!kernelSupported(&kernels[k])){
+			if(automatic) continue;
+			return 0;
+		}
+		kernel = &kernels[k];
+		return 1;
+	}
+	return 0;
+}
+
+const char *staKernelName(void){
+	if(!kernel) staKernel(NULL);
+	return kernel->name;
+}
+
+void staKernelForward(sta_layout *l, int lo, int hi){
+	// arrival times of positions lo..hi-1 of one level above 0
+	if(!kernel) staKernel(NULL);
+	kernel->forward(l, lo, hi);
+}
+
+void staKernelBackward(sta_layout *l, int lo, int hi){
+	// required times of positions lo..hi-1 of one level, the levels above done
+	if(!kernel) staKernel(NULL);
+	kernel->backward(l, lo, hi);
+}
@@ -0,0 +1,188 @@
+#include "ace.h"
+
+// Synthetic benchmark generator: copies of small circuits are stitched into
+// one large AIG, written as binary AIGER. Copies are placed round-robin in
+// STITCH_STAGES stages; the inputs of a stage-s copy are driven by randomly
+// chosen (and randomly inverted) outputs of stage s-1 copies, stage 0 inputs
+// are primary inputs. Outputs that drive nothing, and all outputs of the last
+// stage, become primary outputs, so no logic is dead. The depth stays about
+// STITCH_STAGES times the depth of the sources whatever the size.
+
+#define STITCH_STAGES 8
+#define STITCH_SEED 12345u
+
+typedef struct stitch_aig{
+	// nodes in creation order, a literal is 2*node + complement, node 0 is constant 0
+	unsigned char *is_pi;
+	unsigned int *lit0, *lit1;	// AND fanins
+	unsigned int n, cap, npi, nand;
+	unsigned int *out;	// primary output literals
+	unsigned int nout, capout;
+} stitch_aig;
+
+typedef struct stitch_pool{
+	// outputs of the copies placed in one stage, drivers of the next stage
+	unsigned int *lit;
+	unsigned char *used;
+	unsigned int n, cap;
+} stitch_pool;
+
+static unsigned int stitchRandom(unsigned int *state){
+	// xorshift32, deterministic so the same arguments give the same file
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static unsigned int stitchNode(stitch_aig *a, int is_pi, unsigned int lit0, unsigned int lit1){
+	if(a->n == a->cap){
+		a->cap = a->cap ? a->cap * 2 : 1 << 16;
+		a->is_pi = realloc(a->is_pi, a->cap * sizeof(*a->is_pi));
+		a->lit0 = realloc(a->lit0, a->cap * sizeof(*a->lit0));
+		a->lit1 = realloc(a->lit1, a->cap * sizeof(*a->lit1));
+		if(!a->is_pi || !a->lit0 || !a->lit1){
+			printf("Error: out of memory for %u stitched nodes\n", a->cap);
+			exit(1);
+		}
+	}
+	a->is_pi[a->n] = is_pi;
+	a->lit0[a->n] = lit0;
+	a->lit1[a->n] = lit1;
+	if(is_pi) a->npi++;
+	else a->nand++;
+	return 2 * a->n++;
+}
+
+static void stitchPoolAdd(stitch_pool *p, unsigned int lit){
+	if(p->n == p->cap){
+		p->cap = p->cap ? p->cap * 2 : 1024;
+		p->lit = realloc(p->lit, p->cap * sizeof(*p->lit));
+		p->used = realloc(p->used, p->cap);
+	}
+	p->lit[p->n] = lit;
+	p->used[p->n++] = 0;
+}
+
+static void stitchOutput(stitch_aig *a, unsigned int lit){
+	if(a->nout == a->capout){
+		a->capout = a->capout ? a->capout * 2 : 1024;
+		a->out = realloc(a->out, a->capout * sizeof(*a->out));
+	}
+	a->out[a->nout++] = lit;
+}
+
+static void stitchCopy(stitch_aig *a, timing_graph *src, int *lit, stitch_pool *drivers, stitch_pool *outputs, unsigned int *seed){
+	// append one copy of src, its PIs driven by drivers (NULL: new primary inputs)
+	for(unsigned int i = 0; i < src->n; i++){
+		if(src->type[i] == PI){
+			if(drivers && drivers->n > 0){
+				unsigned int k = stitchRandom(seed) % drivers->n;
+				drivers->used[k] = 1;
+				lit[i] = drivers->lit[k] ^ (stitchRandom(seed) & 1);
+			}else{
+				lit[i] = stitchNode(a, 1, 0, 0);
+			}
+		}else if(src->type[i] == GATE){
+			lit[i] = stitchNode(a, 0, lit[src->fanin0[i]] ^ COMPL0(src, i), lit[src->fanin1[i]] ^ COMPL1(src, i));
+		}else{
+			unsigned int out = src->fanin0[i] < 0 ? COMPL0(src, i) : lit[src->fanin0[i]] ^ COMPL0(src, i);
+			stitchPoolAdd(outputs, out);
+		}
+	}
+}
+
+static int stitchWrite(stitch_aig *a, const char *file_name){
+	// binary AIGER: PIs are variables 1..I, ANDs follow in creation order
+	FILE *file = fopen(file_name, "wb");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		return 0;
+	}
+	unsigned int *var = malloc(a->n * sizeof(unsigned int));
+	unsigned int next_pi = 1, next_and = a->npi + 1;
+	var[0] = 0;
+	for(unsigned int i = 1; i < a->n; i++) var[i] = a->is_pi[i] ? next_pi++ : next_and++;
+	#define STITCH_LIT(l) (2 * var[(l) >> 1] + ((l) & 1))
+
+	fprintf(file, "aig %u %u 0 %u %u\n", a->npi + a->nand, a->npi, a->nout, a->nand);
+	for(unsigned int k = 0; k < a->nout; k++) fprintf(file, "%u\n", STITCH_LIT(a->out[k]));
+	for(unsigned int i = 1; i < a->n; i++){
+		if(a->is_pi[i]) continue;
+		unsigned int lhs = 2 * var[i];
+		unsigned int r0 = STITCH_LIT(a->lit0[i]), r1 = STITCH_LIT(a->lit1[i]);
+		if(r0 < r1){
+			unsigned int t = r0;
+			r0 = r1;
+			r1 = t;
+		}
+		unsigned int delta[2] = {lhs - r0, r0 - r1};
+		for(int d = 0; d < 2; d++){
+			unsigned int x = delta[d];
+			while(x & ~0x7fu){
+				putc((x & 0x7f) | 0x80, file);
+				x >>= 7;
+			}
+			putc(x, file);
+		}
+	}
+	#undef STITCH_LIT
+	fprintf(file, "c\nstitched by ace --stitch\n");
+	free(var);
+	int ok = fclose(file) == 0;
+	if(!ok) printf("Error: cannot write %s\n", file_name);
+	return ok;
+}
+
+int stitchCircuits(char **inputs, int ninputs, long target, const char *file_name){
+	// stitch copies of inputs until at least target AND nodes, write file_name; returns 0 on error
+	if(target < 1 || target > (long)(UINT_MAX / 4)){
+		printf("Error: --stitch node count out of range\n");
+		return 0;
+	}
+	timing_graph *src = calloc(ninputs, sizeof(timing_graph));
+	int max_nodes = 0, ok = 1;
+	for(int k = 0; ok && k < ninputs; k++){
+		size_t bytes;
+		ok = readNetwork(&src[k], inputs[k], &bytes);
+		max_nodes = max(max_nodes, (int)src[k].n);
+	}
+
+	stitch_aig a;
+	stitch_pool pool[STITCH_STAGES];
+	memset(&a, 0, sizeof(a));
+	memset(pool, 0, sizeof(pool));
+	int *lit = malloc(max(max_nodes, 1) * sizeof(int));
+	if(ok){
+		unsigned int seed = STITCH_SEED;
+		int copies = 0;
+		stitchNode(&a, 1, 0, 0); // node 0, constant 0 (not counted as a PI)
+		a.npi = 0;
+		while(a.nand < (unsigned long)target){
+			int stage = copies % STITCH_STAGES;
+			stitchCopy(&a, &src[copies % ninputs], lit, stage ? &pool[stage - 1] : NULL, &pool[stage], &seed);
+			copies++;
+		}
+		for(int s = 0; s < STITCH_STAGES; s++){
+			for(unsigned int k = 0; k < pool[s].n; k++){
+				if(!pool[s].used[k] || s == STITCH_STAGES - 1) stitchOutput(&a, pool[s].lit[k]);
+			}
+		}
+		printf("stitch: %d copies of %d circuits, %u PIs, %u POs, %u AND nodes\n", copies, ninputs, a.npi, a.nout, a.nand);
+		ok = stitchWrite(&a, file_name);
+	}
+
+	// the graphs read so far, a failed read's partial one too (the rest are zeroed)
+	for(int k = 0; k < ninputs; k++) graphFree(&src[k]);
+	for(int s = 0; s < STITCH_STAGES; s++){
+		free(pool[s].lit);
+		free(pool[s].used);
+	}
+	free(src);
+	free(lit);
+	free(a.is_pi);
+	free(a.lit0);
+	free(a.lit1);
+	free(a.out);
+	return ok;
+}
@@ -0,0 +1,287 @@
+#include "ace.h"
+
+// Simulation check of the written netlist (--verify). The .mbench is read back
+// and simulated against the AIG of the input file, read again, on random input
+// patterns: every node holds a 256-bit word, one bit per pattern, so a NAND
+// of 256 patterns is one vector and/not (GCC vector extension, AVX2 or SSE
+// pairs as the build allows). The .mbench doesn't say which net drives an
+// output, so those come from the sized graph, numbered as Write() numbers its
+// cells; everything else is what the file says. A mismatch writes the failing
+// pattern to benchmark_name.cex.
+
+#define VERIFY_ROUNDS 16	// 256-pattern words simulated per node
+#define VERIFY_SEED 0x9e3779b97f4a7c15ull
+
+typedef unsigned long long sim_word __attribute__((vector_size(32)));
+#define SIM_LANES 4	// 64-bit lanes of a sim_word
+
+typedef struct mbench_netlist{
+	// refs as in the .mbin: > 0 cell X<ref>, < 0 input -(ref+1), 0 a constant
+	int npi;
+	char **pi;	// INPUT names in order
+	timing_port *pi_sorted;	// inputs by name, time: the position
+	int ncells, cap;
+	unsigned char *nand;	// per cell X<k+1>: 1 NAND, 0 INV
+	int *in;	// in[2*k], in[2*k+1]: its input refs
+} mbench_netlist;
+
+static int piCompare(const void *a, const void *b){
+	return strcmp(((const timing_port *)a)->name, ((const timing_port *)b)->name);
+}
+
+static int netRef(mbench_netlist *m, char *s, int *ref){
+	// the ref of net s, 0 when s is neither an input nor an earlier cell; inputs first, as
+	// an input named X<n> shadows cell X<n> in the file too
+	timing_port key = {s, 0, 0.0};
+	timing_port *p = bsearch(&key, m->pi_sorted, m->npi, sizeof(timing_port), piCompare);
+	if(p){
+		*ref = -((int)p->time + 1);
+		return 1;
+	}
+	char *end;
+	long id = s[0] == 'X' && s[1] >= '0' && s[1] <= '9' ? strtol(s + 1, &end, 10) : 0;
+	if(id < 1 || id > m->ncells || *end != '\0') return 0;
+	*ref = (int)id;
+	return 1;
+}
+
+static int cellKind(const char *name){
+	// 1: a NAND of the library, 0: an inverter, -1: neither
+	for(unsigned int k = 0; k < nand_count; k++) if(strcmp(name, nands[k].name) == 0) return 1;
+	for(unsigned int k = 0; k < inv_count; k++) if(strcmp(name, inverters[k].name) == 0) return 0;
+	return -1;
+}
+
+static int readMbench(mbench_netlist *m, const char *file_name){
+	// INPUT lines and cells of a .mbench, cells only reading inputs and earlier cells; 0 on an error
+	FILE *file = fopen(file_name, "r");
+	if(!file){
+		printf("Error: verify: cannot open %s\n", file_name);
+		return 0;
+	}
+	char line[4096];
+	int line_no = 0, ok = 1, sorted = 0, pi_cap = 0;
+	while(ok && fgets(line, sizeof(line), file)){
+		line_no++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if(strncmp(line, "INPUT(", 6) == 0){
+			char *end = strchr(line, ')');
+			if(!end || m->ncells > 0){
+				ok = 0;
+				break;
+			}
+			*end = '\0';
+			if(m->npi == pi_cap){
+				pi_cap = pi_cap * 2 + 64;
+				m->pi = realloc(m->pi, pi_cap * sizeof(char *));
+			}
+			m->pi[m->npi++] = strdup(line + 6);
+			continue;
+		}
+		if(line[0] != 'X') continue;	// header and OUTPUT lines
+		if(!sorted){
+			m->pi_sorted = malloc(max(m->npi, 1) * sizeof(timing_port));
+			for(int k = 0; k < m->npi; k++) m->pi_sorted[k] = (timing_port){m->pi[k], 0, k};
+			qsort(m->pi_sorted, m->npi, sizeof(timing_port), piCompare);
+			sorted = 1;
+		}
+		// "X<id> = CELL(in0[, in1])", the slack column after it
+		char *open = strchr(line, '('), *close = open ? strchr(open, ')') : NULL;
+		char *eq = strstr(line, " = ");
+		if(!open || !close || !eq || eq > open || strtol(line + 1, NULL, 10) != m->ncells + 1){
+			ok = 0;
+			break;
+		}
+		*open = *close = '\0';
+		int kind = cellKind(eq + 3);
+		char *comma = strstr(open + 1, ", ");
+		if(comma) *comma = '\0';
+		if(m->ncells == m->cap){
+			m->cap = m->cap * 2 + 1024;
+			m->nand = realloc(m->nand, m->cap);
+			m->in = realloc(m->in, 2 * (size_t)m->cap * sizeof(int));
+			if(!m->nand || !m->in){
+				printf("Error: out of memory for the netlist check\n");
+				exit(1);
+			}
+		}
+		int *in = m->in + 2 * (size_t)m->ncells;
+		in[1] = 0;
+		ok = kind >= 0 && (comma != NULL) == kind && netRef(m, open + 1, &in[0]) && (!comma || netRef(m, comma + 2, &in[1]));
+		m->nand[m->ncells++] = kind;
+	}
+	fclose(file);
+	if(!ok) printf("Error: verify: %s:%d: not a cell of the library reading inputs and earlier cells\n", file_name, line_no);
+	return ok;
+}
+
+static void freeNetlist(mbench_netlist *m){
+	for(int k = 0; k < m->npi; k++) free(m->pi[k]);
+	free(m->pi);
+	free(m->pi_sorted);
+	free(m->nand);
+	free(m->in);
+}
+
+static void outputRefs(timing_graph *g, int *ref, int *cells){
+	// ref of every node's output net in the .mbench, the outputs' drivers among them
+	int pi = 0, gid = 1;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI){
+			ref[i] = -(++pi);
+			continue;
+		}
+		if(g->fanin0[i] < 0){
+			ref[i] = 0;
+			continue;
+		}
+		int inv0 = COMPL0(g, i) ? gid++ : 0;
+		if(g->type[i] == PO) ref[i] = inv0 ? inv0 : ref[g->fanin0[i]];
+		else if(g->type[i] == INVERTER) ref[i] = inv0;
+		else{
+			gid += COMPL1(g, i);
+			ref[i] = gid++;
+		}
+	}
+	*cells = gid - 1;
+}
+
+//***********************************************************
+// simulation
+static void simRandom(unsigned long long *state, sim_word *w){
+	// xorshift64*, one 64-bit lane at a time
+	for(int k = 0; k < SIM_LANES; k++){
+		*state ^= *state >> 12;
+		*state ^= *state << 25;
+		*state ^= *state >> 27;
+		(*w)[k] = *state * 0x2545f4914f6cdd1dull;
+	}
+}
+
+static const sim_word sim_const[2] = {{0, 0, 0, 0}, {~0ull, ~0ull, ~0ull, ~0ull}};
+
+static const sim_word *simRef(const sim_word *cell, const sim_word *pi, int ref, int value){
+	// words are passed by address, a 256-bit value argument would depend on the build's -m flags
+	return ref > 0 ? &cell[ref - 1] : ref < 0 ? &pi[-ref - 1] : &sim_const[value];
+}
+
+static void simAig(timing_graph *o, const sim_word *pi, sim_word *v){
+	// the input circuit: ANDs of complemented edges
+	for(unsigned int i = 0, k = 0; i < o->n; i++){
+		if(o->type[i] == PI){
+			v[i] = pi[k++];
+		}else if(o->fanin0[i] < 0){
+			v[i] = sim_const[COMPL0(o, i)];
+		}else{
+			sim_word a = COMPL0(o, i) ? ~v[o->fanin0[i]] : v[o->fanin0[i]];
+			if(o->type[i] == PO){
+				v[i] = a;
+				continue;
+			}
+			v[i] = a & (COMPL1(o, i) ? ~v[o->fanin1[i]] : v[o->fanin1[i]]);
+		}
+	}
+}
+
+static void simNetlist(const mbench_netlist *m, const sim_word *pi, sim_word *cell){
+	for(int k = 0; k < m->ncells; k++){
+		const int *in = m->in + 2 * (size_t)k;
+		sim_word a = *simRef(cell, pi, in[0], 0);
+		cell[k] = m->nand[k] ? ~(a & *simRef(cell, pi, in[1], 0)) : ~a;
+	}
+}
+
+static void writeCounterexample(const char *file_name, timing_graph *o, const sim_word *pi, int npi, int po, int lane, int bit,
+                                int expected){
+	// the failing pattern: one "name value" line per input
+	FILE *file = fopen(file_name, "w");
+	if(!file){
+		printf("Error: cannot open %s\n", file_name);
+		return;
+	}
+	fprintf(file, "# output %s is %d in the input circuit, %d in the netlist\n", o->name[po], expected, !expected);
+	for(int k = 0; k < npi; k++) fprintf(file, "%s %d\n", o->name[k], (int)((pi[k][lane] >> bit) & 1));
+	fclose(file);
+}
+
+//***********************************************************
+int verifyNetlist(const char *input, const char *netlist_file, timing_graph *g, int verbose){
+	// after Write(): netlist_file against the function of input, g the graph written; returns 0 on a mismatch
+	double t0 = wallTime();
+	timing_graph o;
+	memset(&o, 0, sizeof(o));
+	mbench_netlist m;
+	memset(&m, 0, sizeof(m));
+	size_t bytes;
+	if(!readNetwork(&o, input, &bytes)){
+		graphFree(&o);
+		return 0;
+	}
+	int ok = readMbench(&m, netlist_file);
+	int *ref = malloc(g->n * sizeof(int)), cells;
+	int *po_o = malloc(max(o.n, 1) * sizeof(int)), *po_g = malloc(max(g->n, 1) * sizeof(int));
+	int npo_o = 0, npo_g = 0, npi_o = 0;
+	outputRefs(g, ref, &cells);
+	for(unsigned int i = 0; i < o.n; i++){
+		if(o.type[i] == PO) po_o[npo_o++] = i;
+		npi_o += o.type[i] == PI;
+	}
+	for(unsigned int i = 0; i < g->n; i++) if(g->type[i] == PO) po_g[npo_g++] = i;
+	if(ok){
+		// the readers put the PIs first, in file order; the outputs keep their order through sizing
+		for(int k = 0; ok && k < m.npi && k < npi_o; k++) ok = strcmp(m.pi[k], o.name[k]) == 0;
+		for(int k = 0; ok && k < npo_o && k < npo_g; k++) ok = strcmp(o.name[po_o[k]], g->name[po_g[k]]) == 0;
+		ok = ok && m.npi == npi_o && npo_o == npo_g && m.ncells == cells;
+		if(!ok){
+			printf("Error: verify: %s (%d inputs, %d cells) doesn't have the ports of %s (%d inputs) or the %d cells of the graph\n",
+				netlist_file, m.npi, m.ncells, input, npi_o, cells);
+		}
+	}
+
+	sim_word *pi = malloc(max(m.npi, 1) * sizeof(sim_word));
+	sim_word *v = malloc(max(o.n, 1) * sizeof(sim_word));
+	sim_word *cell = malloc(max(m.ncells, 1) * sizeof(sim_word));
+	if(!pi || !v || !cell){
+		printf("Error: out of memory for the netlist check\n");
+		exit(1);
+	}
+	unsigned long long state = VERIFY_SEED;
+	int round = 0;
+	for(; ok && round < VERIFY_ROUNDS; round++){
+		for(int k = 0; k < m.npi; k++){
+			simRandom(&state, &pi[k]);
+			// the first patterns: all inputs 0, all inputs 1
+			if(round == 0) pi[k][0] = (pi[k][0] & ~3ull) | 2;
+		}
+		simAig(&o, pi, v);
+		simNetlist(&m, pi, cell);
+		for(int k = 0; ok && k < npo_o; k++){
+			int i = po_g[k];
+			sim_word got = *simRef(cell, pi, ref[i], g->fanin0[i] < 0 && COMPL0(g, i));
+			sim_word diff = got ^ v[po_o[k]];
+			for(int lane = 0; lane < SIM_LANES && ok; lane++){
+				if(!diff[lane]) continue;
+				int bit = __builtin_ctzll(diff[lane]);
+				char *cex = outputName(input, ".cex");
+				writeCounterexample(cex, &o, pi, m.npi, po_o[k], lane, bit, (int)((v[po_o[k]][lane] >> bit) & 1));
+				printf("Error: verify: output %s of %s differs from %s, counterexample in %s\n", o.name[po_o[k]],
+					netlist_file, input, cex);
+				free(cex);
+				ok = 0;
+			}
+		}
+	}
+	if(ok && verbose){
+		printf("verify: %d outputs, %d cells equal on %d random patterns in %.4f s\n", npo_o, m.ncells,
+			VERIFY_ROUNDS * SIM_LANES * 64, wallTime() - t0);
+	}
+	free(pi);
+	free(v);
+	free(cell);
+	free(ref);
+	free(po_o);
+	free(po_g);
+	freeNetlist(&m);
+	graphFree(&o);
+	return ok;
+}
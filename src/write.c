@@ -0,0 +1,315 @@
+#include "ace.h"
+
+// Netlist writers. Lines are formatted into one reusable buffer per thread
+// and flushed with fwrite; integers and slacks are formatted by hand, so the
+// per-cell cost is a few memcpy's. The text format is the original .mbench:
+// every cell line is padded to WRITE_COLUMN characters (or overflows it by
+// the same number of spaces, as printf's "%*s" with a negative width did)
+// before its slack.
+//
+// The binary format (.mbin, integers and doubles little-endian on any host):
+//   "MBIN", u32 version, u32 flags (bit0: slacks present),
+//   f64 initial delay, f64 original area, f64 optimized area,
+//   u32 library cells, each: u8 kind (0: INV, 1: NAND), u16 name length, name
+//   u32 PIs, each: u16 name length, name
+//   u32 cells in .mbench order (cell k is X<k+1>), each: u16 library index,
+//       i32 input refs (1 for an INV, 2 for a NAND), f64 slack if flag bit0
+//   u32 POs, each: u16 name length, name, i32 driver ref
+// A ref > 0 is cell X<ref>, a ref < 0 is PI -(ref+1), ref 0 is a constant
+// output whose value follows as one more byte.
+
+#define WRITE_BUFFER (1 << 18)	// flush threshold
+#define WRITE_COLUMN 45	// .mbench slack column
+#define WRITE_NUMBER 320	// longest slack text, "%.2f" of -DBL_MAX (a node nothing reads)
+#define MBIN_VERSION 1
+
+typedef struct out_buffer{
+	FILE *file;
+	size_t n;	// bytes pending in data
+	int error;
+} out_buffer;
+
+static __thread struct{
+	char *data;	// reused by every write of the thread, grows for very long lines
+	size_t cap;
+} wbuf;
+
+static void outFlush(out_buffer *o){
+	if(o->n > 0 && fwrite(wbuf.data, 1, o->n, o->file) != o->n) o->error = 1;
+	o->n = 0;
+}
+
+static char *outReserve(out_buffer *o, size_t need){
+	// room for need more contiguous bytes, returns where they go
+	if(o->n + need > WRITE_BUFFER) outFlush(o);
+	if(o->n + need > wbuf.cap){
+		wbuf.cap = max(WRITE_BUFFER, o->n + need);
+		wbuf.data = realloc(wbuf.data, wbuf.cap);
+		if(!wbuf.data){
+			printf("Error: out of memory for the output buffer\n");
+			exit(1);
+		}
+	}
+	return wbuf.data + o->n;
+}
+
+static char *formatUInt(char *p, unsigned long long v){
+	// decimal digits of v at p, returns the end
+	char digits[20];
+	int n = 0;
+	do{
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	}while(v);
+	while(n > 0) *p++ = digits[--n];
+	return p;
+}
+
+static char *formatFixed2(char *p, double x){
+	// x as printf("%.2f"): the scaled value is rounded directly unless it is too
+	// close to a tie (or too large) to be sure of printf's exact rounding
+	double scaled = fabs(x) * 100.0;
+	if(scaled < 1e15){
+		double r = floor(scaled + 0.5);
+		if(fabs(scaled - r) < 0.5 - 1e-6){
+			unsigned long long v = (unsigned long long)r;
+			if(signbit(x)) *p++ = '-';
+			p = formatUInt(p, v / 100);
+			*p++ = '.';
+			*p++ = '0' + v / 10 % 10;
+			*p++ = '0' + v % 10;
+			return p;
+		}
+	}
+	return p + sprintf(p, "%.2f", x);
+}
+
+typedef struct net_ref{
+	// text of a cell input: a PI name or X<id>
+	const char *s;
+	size_t len;
+	char buf[24];
+} net_ref;
+
+static void refOf(net_ref *r, timing_graph *g, int node, int id){
+	if(g->type[node] == PI){
+		r->s = g->name[node];
+		r->len = strlen(r->s);
+	}else{
+		r->buf[0] = 'X';
+		r->len = formatUInt(r->buf + 1, id) - r->buf;
+		r->s = r->buf;
+	}
+}
+
+static void textCell(out_buffer *o, int gid, const lib_cell *cell, size_t cell_len, const net_ref *in0, const net_ref *in1,
+                     int slack_on, double slack){
+	// "X<gid> = CELL(in0[, in1])", then the padding and " slack : x.xx"
+	char *line = outReserve(o, 64 + WRITE_NUMBER + cell_len + in0->len + (in1 ? in1->len : 0) + WRITE_COLUMN);
+	char *p = line;
+	*p++ = 'X';
+	p = formatUInt(p, gid);
+	memcpy(p, " = ", 3);
+	p += 3;
+	memcpy(p, cell->name, cell_len);
+	p += cell_len;
+	*p++ = '(';
+	memcpy(p, in0->s, in0->len);
+	p += in0->len;
+	if(in1){
+		*p++ = ',';
+		*p++ = ' ';
+		memcpy(p, in1->s, in1->len);
+		p += in1->len;
+	}
+	*p++ = ')';
+	if(slack_on){
+		int pad = abs(WRITE_COLUMN - (int)(p - line));
+		memset(p, ' ', pad);
+		p += pad;
+		memcpy(p, " slack : ", 9);
+		p = formatFixed2(p + 9, FIX_NEG_ZERO(slack));
+	}
+	*p++ = '\n';
+	o->n += p - line;
+}
+
+int Write(const char *pFileName, timing_graph *g, int slack_on){
+	// .mbench text netlist, cells numbered X1, X2, ... in node order (inverters before their NAND);
+	// returns 0 when the file can't be opened or written in full
+	out_buffer o = {fopen(pFileName, "w"), 0, 0};
+	if (o.file == NULL)
+	{
+		fprintf(stdout, "Io_WriteBench(): Cannot open the output file.\n");
+		return 0;
+	}
+
+	char *p = outReserve(&o, 128);
+	o.n += sprintf(p, "Initial delay : %.3f\nOriginal area : %.3f\nOptimized area : %.3f\n",
+		g->initial_delay, g->original_area, g->optimized_area);
+	for(int pass = 0; pass < 2; pass++){
+		for(unsigned int i = 0; i < g->n; i++){
+			if(g->type[i] != (pass == 0 ? PI : PO)) continue;
+			size_t len = strlen(g->name[i]);
+			p = outReserve(&o, len + 10);
+			memcpy(p, pass == 0 ? "INPUT(" : "OUTPUT(", pass == 0 ? 6 : 7);
+			p += pass == 0 ? 6 : 7;
+			memcpy(p, g->name[i], len);
+			p += len;
+			*p++ = ')';
+			*p++ = '\n';
+			o.n = p - wbuf.data;
+		}
+	}
+
+	size_t inv_len[MAX_LIB_CELLS], nand_len[MAX_LIB_CELLS];
+	for(unsigned int k = 0; k < inv_count; k++) inv_len[k] = strlen(inverters[k].name);
+	for(unsigned int k = 0; k < nand_count; k++) nand_len[k] = strlen(nands[k].name);
+	int *nand_gateID = calloc(g->n, sizeof(int)); // renaming
+	net_ref in[2];
+	for (unsigned int i = 0, gid = 1; i < g->n; i++){
+		if(g->type[i] == PI) continue;
+		if(g->fanin0[i] < 0) continue; // constant output, nothing to write
+		int pins = g->type[i] == GATE ? 2 : 1;
+		for(int pin = 0; pin < pins; pin++){
+			int fanin = pin == 0 ? g->fanin0[i] : g->fanin1[i];
+			int inverted = pin == 0 ? COMPL0(g, i) : COMPL1(g, i);
+			refOf(&in[pin], g, fanin, nand_gateID[fanin]);
+			if(!inverted) continue;
+			int cell = pin == 0 ? g->inv0_id[i] : g->inv1_id[i];
+			textCell(&o, gid, &inverters[cell], inv_len[cell], &in[pin], NULL, slack_on,
+				pin == 0 ? g->inv_slack0[i] : g->inv_slack1[i]);
+			// the NAND reads the inverter's output
+			in[pin].buf[0] = 'X';
+			in[pin].len = formatUInt(in[pin].buf + 1, gid++) - in[pin].buf;
+			in[pin].s = in[pin].buf;
+		}
+		if(g->type[i] == INVERTER) nand_gateID[i] = gid - 1; // a shared inverter is read by its fanouts
+		if(g->type[i] != GATE) continue;
+		nand_gateID[i] = gid;
+		textCell(&o, gid++, &nands[g->nand_id[i]], nand_len[g->nand_id[i]], &in[0], &in[1], slack_on, g->slack[i]);
+	}
+	free(nand_gateID);
+
+	outFlush(&o);
+	int ok = fclose(o.file) == 0 && !o.error;
+	if(!ok) printf("Error: cannot write %s\n", pFileName);
+	return ok;
+}
+
+//***********************************************************
+// binary netlist
+static void binBytes(out_buffer *o, const void *data, size_t n){
+	memcpy(outReserve(o, n), data, n);
+	o->n += n;
+}
+
+static void binU32(out_buffer *o, unsigned int v){
+	unsigned char b[4] = {v, v >> 8, v >> 16, v >> 24};
+	binBytes(o, b, 4);
+}
+
+static void binU16(out_buffer *o, unsigned int v){
+	unsigned char b[2] = {v, v >> 8};
+	binBytes(o, b, 2);
+}
+
+static void binF64(out_buffer *o, double x){
+	unsigned long long v;
+	memcpy(&v, &x, 8);
+	binU32(o, (unsigned int)v);
+	binU32(o, (unsigned int)(v >> 32));
+}
+
+static void binName(out_buffer *o, const char *name){
+	size_t len = min(strlen(name), 0xffff);
+	binU16(o, len);
+	binBytes(o, name, len);
+}
+
+int WriteBinary(const char *file_name, timing_graph *g, int slack_on){
+	// .mbin: the same cells and numbering as Write(), see the format above; returns 0 on an error
+	out_buffer o = {fopen(file_name, "wb"), 0, 0};
+	if(o.file == NULL){
+		printf("Error: cannot open %s\n", file_name);
+		return 0;
+	}
+	unsigned int npi = 0, npo = 0, ncell = 0;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI){
+			npi++;
+			continue;
+		}
+		if(g->type[i] == PO) npo++;
+		if(g->fanin0[i] < 0) continue;
+		ncell += COMPL0(g, i) + (g->type[i] == GATE ? COMPL1(g, i) + 1 : 0);
+	}
+
+	binBytes(&o, "MBIN", 4);
+	binU32(&o, MBIN_VERSION);
+	binU32(&o, slack_on ? 1 : 0);
+	binF64(&o, g->initial_delay);
+	binF64(&o, g->original_area);
+	binF64(&o, g->optimized_area);
+	binU32(&o, inv_count + nand_count);
+	for(unsigned int k = 0; k < inv_count; k++){
+		binBytes(&o, "\0", 1);
+		binName(&o, inverters[k].name);
+	}
+	for(unsigned int k = 0; k < nand_count; k++){
+		binBytes(&o, "\1", 1);
+		binName(&o, nands[k].name);
+	}
+	// refs: PIs are numbered in node order, cells as in Write()
+	int *ref = calloc(g->n, sizeof(int));
+	binU32(&o, npi);
+	for(unsigned int i = 0, k = 0; i < g->n; i++){
+		if(g->type[i] != PI) continue;
+		ref[i] = -(int)++k;
+		binName(&o, g->name[i]);
+	}
+	binU32(&o, ncell);
+	int cell_id = 1;
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] == PI || g->fanin0[i] < 0) continue;
+		int pins = g->type[i] == GATE ? 2 : 1;
+		int in_ref[2];
+		for(int pin = 0; pin < pins; pin++){
+			in_ref[pin] = ref[pin == 0 ? g->fanin0[i] : g->fanin1[i]];
+			if(!(pin == 0 ? COMPL0(g, i) : COMPL1(g, i))) continue;
+			binU16(&o, pin == 0 ? g->inv0_id[i] : g->inv1_id[i]);
+			binU32(&o, in_ref[pin]);
+			if(slack_on) binF64(&o, FIX_NEG_ZERO(pin == 0 ? g->inv_slack0[i] : g->inv_slack1[i]));
+			in_ref[pin] = cell_id++;
+		}
+		if(g->type[i] != GATE){
+			ref[i] = in_ref[0]; // the PO's driver, or the shared inverter
+			continue;
+		}
+		binU16(&o, inv_count + g->nand_id[i]);
+		binU32(&o, in_ref[0]);
+		binU32(&o, in_ref[1]);
+		if(slack_on) binF64(&o, FIX_NEG_ZERO(g->slack[i]));
+		ref[i] = cell_id++;
+	}
+	binU32(&o, npo);
+	for(unsigned int i = 0; i < g->n; i++){
+		if(g->type[i] != PO) continue;
+		binName(&o, g->name[i]);
+		binU32(&o, g->fanin0[i] < 0 ? 0 : ref[i]);
+		if(g->fanin0[i] < 0) binBytes(&o, COMPL0(g, i) ? "\1" : "\0", 1);
+	}
+	free(ref);
+
+	outFlush(&o);
+	int ok = fclose(o.file) == 0 && !o.error;
+	if(!ok) printf("Error: cannot write %s\n", file_name);
+	return ok;
+}
+
+void writeThreadDone(){
+	// release the calling thread's output buffer, call before a thread that wrote exits
+	free(wbuf.data);
+	wbuf.data = NULL;
+	wbuf.cap = 0;
+}